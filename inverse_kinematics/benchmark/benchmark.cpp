@@ -0,0 +1,490 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <memory>
+
+#include "ik_core.h"
+
+//headless solvers benchmark, prints results as JSON to stdout
+//usage: benchmark [--solvers ccd,chain,fabrik,jt,dls,sdls,analytic] [--bones 6,16,32] [--joints euler,quaternion] [--targets 1000] [--regions 0] [--warm-start] [--seed 1]
+//       benchmark --threads 1,2,4,8 [--lockstep] [--bones 6,16,32] [--joints euler,quaternion] [--targets 1000] [--regions 0] [--seed 1]
+//       benchmark --verify-lockstep [--bones 6,16,32] [--targets 1000] [--regions 0] [--seed 1]
+//analytic is run only when asked for and only for chains of 2 or 3 bones, other ones are never limbs,
+//with --threads all targets are solved as one CCD batch on a pool of each given size (0 is one thread per core),
+//--verify-lockstep compares the lockstep kernel with Skeleton::SolveCCD iteration by iteration and exits with 1 if they differ
+
+#define BONE_LENGTH 0.4f
+#define DEFAULT_TARGETS_NUM 1000
+#define DEFAULT_SEED 1
+#define VERIFY_POSE_TOLERANCE 1e-3f //largest distance between bone ends of the scalar and the lockstep pose after one iteration
+#define VERIFY_DIVERGED_RATE 0.01 //share of iterations allowed to exceed the tolerance
+
+struct SolverEntry
+{
+	const char* name;
+	IKSolver* solver;
+	int maxIterations;
+	bool limbsOnly; //closed form solver, not in the default list and skipped for chains that are not limbs
+};
+
+struct BenchmarkResult
+{
+	double solvesPerSecond;
+	double latencyP50;
+	double latencyP99;
+	double latencyMax;
+	double iterationsMean;
+	int iterationsP50;
+	int iterationsP99;
+	int iterationsMax;
+	double convergenceRate;
+	double cacheHitRate;
+};
+
+struct BatchResult
+{
+	double solvesPerSecond;
+	double convergenceRate;
+};
+
+struct VerifyResult
+{
+	int stepsNum;
+	int divergedNum;
+	float maxPoseDifference;
+	bool passed;
+};
+
+//same chain as in the viewer, bones are alternately bent by 10 degrees
+Skeleton CreateChain(int bonesNum, int& endEffectorIndex)
+{
+	Bone* root = new Bone(0.0f);
+	Bone* bone = root->AddChild(new Bone(BONE_LENGTH));
+
+	for (int i = 1; i < bonesNum; i++)
+		bone = bone->AddChild(new Bone(BONE_LENGTH))->SetRotate(0.0f, i % 2 ? 10.0f : -10.0f, 0.0f);
+
+	std::vector<Bone*> bones;
+	Skeleton skeleton(root, &bones);
+	endEffectorIndex = (int)(std::find(bones.begin(), bones.end(), bone) - bones.begin());
+
+	delete root;
+
+	return skeleton;
+}
+
+//targets inside the viewer target box, height goes from the floor so the default chain can reach part of them,
+//with regionsNum > 0 targets are scattered within a cache cell around regionsNum random points that are revisited in random order
+std::vector<glm::vec3> CreateTargets(int targetsNum, int regionsNum, unsigned int seed)
+{
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> width(-TARGET_WIDTH_LENGTH_LIMIT / 2, TARGET_WIDTH_LENGTH_LIMIT / 2);
+	std::uniform_real_distribution<float> height(0.0f, TARGET_HEIGHT_MAX_LIMIT);
+	std::uniform_real_distribution<float> jitter(-CACHE_CELL_SIZE / 2, CACHE_CELL_SIZE / 2);
+
+	std::vector<glm::vec3> regions(regionsNum);
+
+	for (int i = 0; i < regionsNum; i++)
+		regions[i] = glm::vec3(width(generator), height(generator), width(generator));
+
+	std::vector<glm::vec3> targets(targetsNum);
+
+	for (int i = 0; i < targetsNum; i++)
+	{
+		if (regionsNum > 0)
+		{
+			const glm::vec3& region = regions[generator() % regionsNum];
+			targets[i] = region + glm::vec3(jitter(generator), jitter(generator), jitter(generator));
+			continue;
+		}
+
+		targets[i].x = width(generator);
+		targets[i].y = height(generator);
+		targets[i].z = width(generator);
+	}
+
+	return targets;
+}
+
+template<typename T>
+T Percentile(std::vector<T> values, double percentile)
+{
+	std::sort(values.begin(), values.end());
+	size_t index = (size_t)(percentile * (values.size() - 1) + 0.5);
+
+	return values[index];
+}
+
+//targets are solved one after another starting from the previous pose as in the viewer,
+//with warmStart the pose is seeded from the cache the same way IKContext does and seeding time is measured too
+BenchmarkResult RunBenchmark(const SolverEntry& entry, const Skeleton& chain, int endEffectorIndex, const std::vector<glm::vec3>& targets, bool warmStart)
+{
+	Skeleton skeleton = chain;
+	IKWarmStartCache cache(glm::vec3(-TARGET_WIDTH_LENGTH_LIMIT / 2, 0.0f, -TARGET_WIDTH_LENGTH_LIMIT / 2),
+		glm::vec3(TARGET_WIDTH_LENGTH_LIMIT / 2, TARGET_HEIGHT_MAX_LIMIT, TARGET_WIDTH_LENGTH_LIMIT / 2));
+	std::vector<double> latencies(targets.size());
+	std::vector<int> iterations(targets.size());
+	int convergedNum = 0;
+	double totalTime = 0.0;
+	double totalIterations = 0.0;
+
+	for (size_t i = 0; i < targets.size(); i++)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		if (warmStart)
+			cache.Seed(skeleton, endEffectorIndex, targets[i]);
+
+		bool converged = entry.solver->Solve(skeleton, endEffectorIndex, targets[i], entry.maxIterations, EPSILON);
+
+		if (warmStart && converged)
+			cache.Store(skeleton, targets[i]);
+
+		auto end = std::chrono::high_resolution_clock::now();
+
+		latencies[i] = std::chrono::duration<double, std::micro>(end - start).count();
+		iterations[i] = entry.solver->iterationsNum;
+		totalTime += latencies[i];
+		totalIterations += iterations[i];
+
+		if (converged)
+			convergedNum++;
+	}
+
+	BenchmarkResult result;
+	result.solvesPerSecond = totalTime > 0.0 ? targets.size() * 1e6 / totalTime : 0.0;
+	result.latencyP50 = Percentile(latencies, 0.5);
+	result.latencyP99 = Percentile(latencies, 0.99);
+	result.latencyMax = *std::max_element(latencies.begin(), latencies.end());
+	result.iterationsMean = totalIterations / targets.size();
+	result.iterationsP50 = Percentile(iterations, 0.5);
+	result.iterationsP99 = Percentile(iterations, 0.99);
+	result.iterationsMax = *std::max_element(iterations.begin(), iterations.end());
+	result.convergenceRate = (double)convergedNum / targets.size();
+	result.cacheHitRate = (double)cache.hitsNum / targets.size();
+
+	return result;
+}
+
+//every target is solved by its own copy of the chain starting from the same pose, only the batch call is measured
+BatchResult RunBatchBenchmark(const Skeleton& chain, int endEffectorIndex, const std::vector<glm::vec3>& targets, ThreadPool& pool, bool lockstep)
+{
+	int count = (int)targets.size();
+	std::vector<Skeleton> skeletons(count, chain);
+	std::vector<int> endEffectorIndices(count, endEffectorIndex);
+	std::unique_ptr<bool[]> converged(new bool[count]);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	if (lockstep)
+		SolveCCDBatchLockstep(skeletons.data(), endEffectorIndex, targets.data(), converged.get(), count, CCD_ITERATIONS_NUM, EPSILON, pool);
+	else
+		SolveCCDBatch(skeletons.data(), endEffectorIndices.data(), targets.data(), converged.get(), count, CCD_ITERATIONS_NUM, EPSILON, pool);
+
+	auto end = std::chrono::high_resolution_clock::now();
+
+	double totalTime = std::chrono::duration<double, std::micro>(end - start).count();
+	int convergedNum = (int)std::count(converged.get(), converged.get() + count, true);
+
+	BatchResult result;
+	result.solvesPerSecond = totalTime > 0.0 ? count * 1e6 / totalTime : 0.0;
+	result.convergenceRate = (double)convergedNum / count;
+
+	return result;
+}
+
+//every target is solved by Skeleton::SolveCCD and by the lockstep kernel one iteration at a time, both start every
+//iteration from the scalar pose, so last bit differences (approximated trigonometry, fused multiply-adds) are not
+//amplified by a long run, an iteration diverges if converged flags differ or a bone end is off by more than
+//VERIFY_POSE_TOLERANCE, a few do when a joint is right at a limit or at the rotation threshold, a bug makes most of them
+VerifyResult VerifyLockstep(const Skeleton& chain, int endEffectorIndex, const std::vector<glm::vec3>& targets)
+{
+	ThreadPool pool(1);
+	int count = (int)targets.size();
+	std::vector<Skeleton> scalarSkeletons(count, chain);
+	std::vector<Skeleton> lockstepSkeletons;
+	std::unique_ptr<bool[]> scalarConverged(new bool[count]());
+	std::unique_ptr<bool[]> lockstepConverged(new bool[count]);
+	int activeNum = count;
+
+	VerifyResult result;
+	result.stepsNum = 0;
+	result.divergedNum = 0;
+	result.maxPoseDifference = 0.0f;
+
+	for (int i = 0; i < CCD_ITERATIONS_NUM && activeNum > 0; i++)
+	{
+		lockstepSkeletons = scalarSkeletons;
+		SolveCCDBatchLockstep(lockstepSkeletons.data(), endEffectorIndex, targets.data(), lockstepConverged.get(), count, 1, EPSILON, pool);
+
+		for (int t = 0; t < count; t++)
+		{
+			if (scalarConverged[t])
+				continue;
+
+			Skeleton& scalarSkeleton = scalarSkeletons[t];
+			Skeleton& lockstepSkeleton = lockstepSkeletons[t];
+			scalarConverged[t] = scalarSkeleton.SolveCCD(endEffectorIndex, targets[t], 1, EPSILON);
+			scalarSkeleton.CalcTransforms();
+			result.stepsNum++;
+
+			if (scalarConverged[t])
+				activeNum--;
+
+			//one of them stopped at another bone, so the poses are not compared
+			if (scalarConverged[t] != lockstepConverged[t])
+			{
+				result.divergedNum++;
+				continue;
+			}
+
+			float stepDifference = 0.0f;
+
+			for (int b = 0; b < chain.Size(); b++)
+				stepDifference = std::max(stepDifference, glm::length(glm::vec3(scalarSkeleton.GetBoneEnd(b)) - glm::vec3(lockstepSkeleton.GetBoneEnd(b))));
+
+			if (stepDifference > VERIFY_POSE_TOLERANCE)
+				result.divergedNum++;
+
+			result.maxPoseDifference = std::max(result.maxPoseDifference, stepDifference);
+		}
+	}
+
+	result.passed = result.divergedNum <= result.stepsNum * VERIFY_DIVERGED_RATE;
+
+	return result;
+}
+
+std::vector<std::string> SplitList(const char* list)
+{
+	std::vector<std::string> items;
+	std::string item;
+
+	for (const char* c = list; ; c++)
+	{
+		if (*c == ',' || *c == '\0')
+		{
+			if (!item.empty())
+				items.push_back(item);
+
+			item.clear();
+
+			if (*c == '\0')
+				break;
+		}
+		else
+			item += *c;
+	}
+
+	return items;
+}
+
+int main(int argc, char* argv[])
+{
+	CCDSolver ccdSolver;
+	ChainCCDSolver chainSolver;
+	FABRIKSolver fabrikSolver;
+	JacobianTransposeSolver jacobianTransposeSolver;
+	DLSSolver dlsSolver;
+	SDLSSolver sdlsSolver;
+	AnalyticSolver analyticSolver(&dlsSolver);
+
+	SolverEntry allSolvers[] =
+	{
+		{ "ccd", &ccdSolver, CCD_ITERATIONS_NUM, false },
+		{ "chain", &chainSolver, CCD_ITERATIONS_NUM, false },
+		{ "fabrik", &fabrikSolver, FABRIK_ITERATIONS_NUM, false },
+		{ "jt", &jacobianTransposeSolver, JACOBIAN_ITERATIONS_NUM, false },
+		{ "dls", &dlsSolver, JACOBIAN_ITERATIONS_NUM, false },
+		{ "sdls", &sdlsSolver, JACOBIAN_ITERATIONS_NUM, false },
+		{ "analytic", &analyticSolver, JACOBIAN_ITERATIONS_NUM, true },
+	};
+	int allSolversNum = sizeof(allSolvers) / sizeof(allSolvers[0]);
+
+	std::vector<std::string> solverNames;
+	std::vector<std::string> bonesList = SplitList("6,16,32");
+	std::vector<std::string> jointsList = SplitList("euler");
+	std::vector<std::string> threadsList;
+	int targetsNum = DEFAULT_TARGETS_NUM;
+	int regionsNum = 0;
+	bool warmStart = false;
+	bool lockstep = false;
+	bool verifyLockstep = false;
+	bool verifyPassed = true;
+	unsigned int seed = DEFAULT_SEED;
+
+	for (int i = 0; i < allSolversNum; i++)
+		if (!allSolvers[i].limbsOnly)
+			solverNames.push_back(allSolvers[i].name);
+
+	for (int i = 1; i < argc; i++)
+	{
+		bool hasValue = i + 1 < argc;
+
+		if (!strcmp(argv[i], "--solvers") && hasValue)
+			solverNames = SplitList(argv[++i]);
+		else if (!strcmp(argv[i], "--bones") && hasValue)
+			bonesList = SplitList(argv[++i]);
+		else if (!strcmp(argv[i], "--joints") && hasValue)
+			jointsList = SplitList(argv[++i]);
+		else if (!strcmp(argv[i], "--targets") && hasValue)
+			targetsNum = std::max(1, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--regions") && hasValue)
+			regionsNum = std::max(0, atoi(argv[++i]));
+		else if (!strcmp(argv[i], "--warm-start"))
+			warmStart = true;
+		else if (!strcmp(argv[i], "--threads") && hasValue)
+			threadsList = SplitList(argv[++i]);
+		else if (!strcmp(argv[i], "--lockstep"))
+			lockstep = true;
+		else if (!strcmp(argv[i], "--verify-lockstep"))
+			verifyLockstep = true;
+		else if (!strcmp(argv[i], "--seed") && hasValue)
+			seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+		else
+		{
+			fprintf(stderr, "usage: %s [--solvers ccd,chain,fabrik,jt,dls,sdls,analytic] [--bones 6,16,32] [--joints euler,quaternion] [--targets N] [--regions N] [--warm-start] [--seed N]\n", argv[0]);
+			fprintf(stderr, "       %s --threads N,N,... [--lockstep] [--bones 6,16,32] [--joints euler,quaternion] [--targets N] [--regions N] [--seed N]\n", argv[0]);
+			fprintf(stderr, "       %s --verify-lockstep [--bones 6,16,32] [--targets N] [--regions N] [--seed N]\n", argv[0]);
+			return 1;
+		}
+	}
+
+	std::vector<glm::vec3> targets = CreateTargets(targetsNum, regionsNum, seed);
+
+	printf("{\n");
+	printf("  \"seed\": %u,\n", seed);
+	printf("  \"targets\": %d,\n", targetsNum);
+	printf("  \"regions\": %d,\n", regionsNum);
+	printf("  \"warm_start\": %s,\n", warmStart ? "true" : "false");
+
+	if (!threadsList.empty())
+		printf("  \"lockstep\": %s,\n", lockstep ? "true" : "false");
+
+	printf("  \"epsilon\": %g,\n", EPSILON);
+
+	if (verifyLockstep)
+	{
+		printf("  \"exact_trig\": %s,\n", IK_SIMD_EXACT_TRIG ? "true" : "false");
+		printf("  \"simd_width\": %d,\n", IK_SIMD_WIDTH);
+		printf("  \"tolerance\": %g,\n", VERIFY_POSE_TOLERANCE);
+		printf("  \"diverged_rate\": %g,\n", VERIFY_DIVERGED_RATE);
+	}
+
+	printf("  \"results\": [");
+
+	bool first = true;
+
+	for (size_t b = 0; b < bonesList.size(); b++)
+	{
+		int bonesNum = std::max(1, atoi(bonesList[b].c_str()));
+		int endEffectorIndex;
+		Skeleton chain = CreateChain(bonesNum, endEffectorIndex);
+
+		for (size_t j = 0; j < jointsList.size(); j++)
+		{
+			bool quaternionJoints = jointsList[j] == "quaternion";
+
+			if (!quaternionJoints && jointsList[j] != "euler")
+			{
+				fprintf(stderr, "unknown joints %s\n", jointsList[j].c_str());
+				return 1;
+			}
+
+			Skeleton jointsChain = chain;
+
+			if (quaternionJoints)
+				jointsChain.UseQuaternionJoints();
+
+			if (verifyLockstep)
+			{
+				VerifyResult result = VerifyLockstep(jointsChain, endEffectorIndex, targets);
+				verifyPassed = verifyPassed && result.passed;
+
+				printf("%s\n    {\n", first ? "" : ",");
+				printf("      \"solver\": \"ccd_lockstep\",\n");
+				printf("      \"bones\": %d,\n", bonesNum);
+				printf("      \"joints\": \"%s\",\n", quaternionJoints ? "quaternion" : "euler");
+				printf("      \"steps\": %d,\n", result.stepsNum);
+				printf("      \"diverged\": %d,\n", result.divergedNum);
+				printf("      \"max_pose_difference\": %g,\n", result.maxPoseDifference);
+				printf("      \"passed\": %s\n", result.passed ? "true" : "false");
+				printf("    }");
+				first = false;
+				continue;
+			}
+
+			double baseSolvesPerSecond = 0.0;
+
+			for (size_t t = 0; t < threadsList.size(); t++)
+			{
+				ThreadPool pool(atoi(threadsList[t].c_str()));
+				BatchResult result = RunBatchBenchmark(jointsChain, endEffectorIndex, targets, pool, lockstep);
+
+				if (t == 0)
+					baseSolvesPerSecond = result.solvesPerSecond;
+
+				printf("%s\n    {\n", first ? "" : ",");
+				printf("      \"solver\": \"%s\",\n", lockstep ? "ccd_lockstep" : "ccd_batch");
+				printf("      \"bones\": %d,\n", bonesNum);
+				printf("      \"joints\": \"%s\",\n", quaternionJoints ? "quaternion" : "euler");
+				printf("      \"threads\": %d,\n", pool.ThreadsNum());
+				printf("      \"max_iterations\": %d,\n", CCD_ITERATIONS_NUM);
+				printf("      \"solves_per_second\": %.1f,\n", result.solvesPerSecond);
+				printf("      \"speedup\": %.2f,\n", baseSolvesPerSecond > 0.0 ? result.solvesPerSecond / baseSolvesPerSecond : 0.0);
+				printf("      \"convergence_rate\": %.4f\n", result.convergenceRate);
+				printf("    }");
+				first = false;
+			}
+
+			if (!threadsList.empty())
+				continue;
+
+			for (size_t s = 0; s < solverNames.size(); s++)
+			{
+				const SolverEntry* entry = NULL;
+
+				for (int i = 0; i < allSolversNum; i++)
+					if (solverNames[s] == allSolvers[i].name)
+						entry = &allSolvers[i];
+
+				if (entry == NULL)
+				{
+					fprintf(stderr, "unknown solver %s\n", solverNames[s].c_str());
+					return 1;
+				}
+
+				//it would only measure its fallback
+				if (entry->limbsOnly && !AnalyticSolver::IsLimb(jointsChain, endEffectorIndex))
+				{
+					fprintf(stderr, "skipping %s for %d bones, it solves only chains of %d to %d bones\n", entry->name, bonesNum, ANALYTIC_MIN_BONES, ANALYTIC_MAX_BONES);
+					continue;
+				}
+
+				BenchmarkResult result = RunBenchmark(*entry, jointsChain, endEffectorIndex, targets, warmStart);
+
+				printf("%s\n    {\n", first ? "" : ",");
+				printf("      \"solver\": \"%s\",\n", entry->name);
+				printf("      \"bones\": %d,\n", bonesNum);
+				printf("      \"joints\": \"%s\",\n", quaternionJoints ? "quaternion" : "euler");
+				printf("      \"max_iterations\": %d,\n", entry->maxIterations);
+				printf("      \"solves_per_second\": %.1f,\n", result.solvesPerSecond);
+				printf("      \"latency_us\": { \"p50\": %.2f, \"p99\": %.2f, \"max\": %.2f },\n", result.latencyP50, result.latencyP99, result.latencyMax);
+				printf("      \"iterations\": { \"mean\": %.2f, \"p50\": %d, \"p99\": %d, \"max\": %d },\n", result.iterationsMean, result.iterationsP50, result.iterationsP99, result.iterationsMax);
+				printf("      \"convergence_rate\": %.4f,\n", result.convergenceRate);
+				printf("      \"cache_hit_rate\": %.4f\n", result.cacheHitRate);
+				printf("    }");
+				first = false;
+			}
+		}
+	}
+
+	printf("\n  ]\n}\n");
+
+	return verifyPassed ? 0 : 1;
+}
@@ -0,0 +1,124 @@
+#ifndef ANALYTIC_SOLVER_HEADER
+#define ANALYTIC_SOLVER_HEADER
+
+#include "ik_solver.h"
+
+#define ANALYTIC_MIN_BONES 2
+#define ANALYTIC_MAX_BONES 3
+
+//closed form IK for limbs of two and three bones, joint positions come from the law of cosines and the limb keeps bending
+//to the side of its current middle joint (pole), in three bone limbs the last bone points along the target direction,
+//other chains, targets that need a folded limb and poses changed by joint limits are passed to the fallback solver
+class AnalyticSolver : public IKSolver
+{
+public:
+	IKSolver* fallback;
+
+	AnalyticSolver(IKSolver* fallback = NULL)
+	{
+		this->fallback = fallback;
+	}
+
+	//true if the chain ending with endEffectorIndex can be solved in closed form, root bone is not counted as it is never rotated
+	static bool IsLimb(const Skeleton& skeleton, int endEffectorIndex)
+	{
+		int bonesNum = 0;
+
+		for (int i = skeleton.parentIndices[endEffectorIndex]; i >= 0; i = skeleton.parentIndices[i])
+			bonesNum++;
+
+		return bonesNum >= ANALYTIC_MIN_BONES && bonesNum <= ANALYTIC_MAX_BONES;
+	}
+
+	bool Solve(Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target, int maxIterations, float epsilon)
+	{
+		if (!IsLimb(skeleton, endEffectorIndex))
+			return Fallback(skeleton, endEffectorIndex, target, maxIterations, epsilon, 0);
+
+		skeleton.GetChain(endEffectorIndex, chain);
+
+		for (size_t c = 0; c < chain.size(); c++)
+			skeleton.CalcTransform(chain[c]);
+
+		int bonesNum = (int)chain.size() - 1;
+		float upperLength = skeleton.boneLengths[chain[1]];
+		float lowerLength = skeleton.boneLengths[chain[2]];
+		float lastLength = bonesNum == 3 ? skeleton.boneLengths[chain[3]] : 0.0f;
+
+		glm::vec3 base = glm::vec3(skeleton.GetBoneEnd(chain[0]));
+		glm::vec3 toTarget = target - base;
+		float distance = glm::length(toTarget);
+
+		//distance from the base to the end of the second bone
+		float reach = std::min(distance - lastLength, upperLength + lowerLength);
+
+		//limb would have to fold, there is no unique closed form pose for that,
+		//reach near zero is also left to the fallback, equal bones would divide zero by zero below
+		if (distance < 1e-6f || reach < std::max(fabs(upperLength - lowerLength), 1e-6f))
+			return Fallback(skeleton, endEffectorIndex, target, maxIterations, epsilon, 0);
+
+		glm::vec3 direction = toTarget / distance;
+
+		glm::vec3 pole = glm::vec3(skeleton.GetBoneEnd(chain[1])) - base;
+		pole -= direction * glm::dot(pole, direction);
+
+		//straight limb has no bend side yet
+		if (glm::dot(pole, pole) < 1e-12f)
+			pole = glm::cross(direction, fabs(direction.x) < 0.9f ? X_AXIS_3 : Y_AXIS_3);
+
+		pole = glm::normalize(pole);
+
+		float cosAngle = glm::clamp((upperLength * upperLength + reach * reach - lowerLength * lowerLength) / (2.0f * upperLength * reach), -1.0f, 1.0f);
+		float sinAngle = sqrt(1.0f - cosAngle * cosAngle);
+
+		positions[1] = base + upperLength * (direction * cosAngle + pole * sinAngle);
+		positions[2] = base + direction * reach;
+		positions[3] = positions[2] + direction * lastLength;
+
+		for (int c = 1; c <= bonesNum; c++)
+			skeleton.RotateTowards(chain[c], positions[c]);
+
+		iterationsNum = 1;
+		TraceResidual(skeleton, endEffectorIndex, target);
+
+		glm::vec3 differnce = glm::vec3(skeleton.GetBoneEnd(endEffectorIndex)) - target;
+
+		if (dot(differnce, differnce) < epsilon)
+			return true;
+
+		//target is out of reach and the limb is straight towards it, which is the best possible pose
+		bool placed = true;
+
+		for (int c = 1; c <= bonesNum; c++)
+		{
+			glm::vec3 placementError = glm::vec3(skeleton.GetBoneEnd(chain[c])) - positions[c];
+			placed = placed && dot(placementError, placementError) < epsilon;
+		}
+
+		if (placed)
+			return false;
+
+		//joint limits (or inexact fit of Euler angles) moved the limb, iterative solver continues from this pose
+		return Fallback(skeleton, endEffectorIndex, target, maxIterations, epsilon, 1);
+	}
+
+private:
+	std::vector<int> chain;
+	glm::vec3 positions[ANALYTIC_MAX_BONES + 1];
+
+	bool Fallback(Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target, int maxIterations, float epsilon, int iterationsDone)
+	{
+		iterationsNum = iterationsDone;
+
+		if (fallback == NULL)
+			return false;
+
+		fallback->residuals = residuals;
+		bool converged = fallback->Solve(skeleton, endEffectorIndex, target, maxIterations, epsilon);
+		iterationsNum += fallback->iterationsNum;
+
+		return converged;
+	}
+};
+
+#endif
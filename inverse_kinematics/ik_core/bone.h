@@ -0,0 +1,193 @@
+#ifndef BONE_HEADER
+#define BONE_HEADER
+
+#include <vector>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "glm/gtc/matrix_transform.hpp"
+#include "glm/gtc/type_ptr.hpp"
+#include "joint_limits.h"
+
+#define X_AXIS_3 glm::vec3(1.0f, 0.0f, 0.0f)
+#define Y_AXIS_3 glm::vec3(0.0f, 1.0f, 0.0f)
+#define Z_AXIS_3 glm::vec3(0.0f, 0.0f, 1.0f)
+#define X_AXIS_4 glm::vec4(1.0f, 0.0f, 0.0f, 0.0f)
+#define Y_AXIS_4 glm::vec4(0.0f, 1.0f, 0.0f, 0.0f)
+#define Z_AXIS_4 glm::vec4(0.0f, 0.0f, 1.0f, 0.0f)
+#define W_AXIS_4 glm::vec4(0.0f, 0.0f, 0.0f, 1.0f)
+
+
+//world transform of the root bone, skeleton stands along Y axis
+inline const glm::mat4& InitialSceletonRotation()
+{
+	static const glm::mat4 rotation = glm::rotate(glm::mat4(), -90.0f, X_AXIS_3);
+	return rotation;
+}
+
+class Bone
+{
+public:
+	Bone* parent;
+	std::vector<Bone*> childrenBones;
+	glm::mat4 transform;
+	glm::vec3 rotation;
+	glm::vec3 constraint[2]; //angle constrains
+	float boneLength;
+
+	Bone(float length)
+	{
+		parent = NULL;
+		transform = glm::mat4(1.0f);
+		worldTransform = glm::mat4(1.0f);
+		worldTransformDirty = true;
+		rotation = glm::vec3(0.0f);
+		constraint[0] = glm::vec3(-360.0f);
+		constraint[1] = glm::vec3(360.0f);
+		boneLength = length;
+	}
+
+	Bone(const Bone& b)
+	{
+		parent = NULL;
+		transform = glm::mat4(b.transform);
+		worldTransform = glm::mat4(1.0f);
+		worldTransformDirty = true;
+		rotation = glm::vec3(b.rotation);
+		constraint[0] = glm::vec3(b.constraint[0]);
+		constraint[1] = glm::vec3(b.constraint[1]);
+		boneLength = b.boneLength;
+
+		for (auto it = b.childrenBones.begin(); it != b.childrenBones.end(); ++it)
+			AddChild(new Bone(**it));
+	}
+
+	//bone owns its children, deleting the root frees the whole tree
+	~Bone()
+	{
+		for (auto it = childrenBones.begin(); it != childrenBones.end(); ++it)
+			delete *it;
+	}
+
+	Bone& operator=(const Bone&) = delete;
+
+	Bone* AddChild(Bone* b)
+	{
+		b->parent = this;
+		childrenBones.push_back(b);
+		b->Invalidate();
+		return b;
+	}
+
+	Bone* SetRotate(float x, float y, float z)
+	{
+		rotation = glm::vec3(fmod(x, 360.0f), fmod(y, 360.0f), fmod(z, 360.0f));
+		Invalidate();
+		return this;
+	}
+
+    Bone* CheckConstrainsAndMax(glm::vec3 delta)
+	{
+		ClampAngleChanges(delta, rotation, constraint[0], constraint[1]);
+
+		SetRotate(rotation.x + delta.x, rotation.y + delta.y, rotation.z + delta.z);
+
+		return this;
+	}
+
+	glm::vec4 GetBoneEnd()
+	{
+		return glm::translate(CalcTransform(), Z_AXIS_3 * boneLength) * W_AXIS_4;
+	}
+
+	//marks cached world transform of this bone and all its descendants as outdated
+	void Invalidate()
+	{
+		//descendants of a dirty bone are always dirty too, so there is nothing left to do
+		if (worldTransformDirty)
+			return;
+
+		worldTransformDirty = true;
+
+		for (auto it = childrenBones.begin(); it != childrenBones.end(); ++it)
+			(*it)->Invalidate();
+	}
+
+	//transform of the bone relatively to its parent bone
+	static glm::mat4 CalcLocalTransform(const glm::vec3& rotation, float parentLength)
+	{
+		glm::mat4 localTransform = glm::translate(glm::mat4(), Z_AXIS_3 * parentLength);
+		localTransform = glm::rotate(localTransform, rotation.x, glm::vec3(localTransform * X_AXIS_4));
+		localTransform = glm::rotate(localTransform, rotation.y, glm::vec3(localTransform * Y_AXIS_4));
+		localTransform = glm::rotate(localTransform, rotation.z, glm::vec3(localTransform * Z_AXIS_4));
+
+		return localTransform;
+	}
+
+	//axes of instant rotation caused by changing each of the three angles, in the parent bone space,
+	//rotations in CalcLocalTransform are applied around already rotated axes so the chain rule is followed through all of them
+	static void CalcLocalRotationAxes(const glm::vec3& rotation, glm::vec3 axes[3])
+	{
+		glm::mat3 localRotation(1.0f);
+		glm::mat3 derivatives[3] = { glm::mat3(0.0f), glm::mat3(0.0f), glm::mat3(0.0f) };
+
+		for (int i = 0; i < 3; i++)
+		{
+			glm::vec3 axis = localRotation[i];
+			float axisLength = glm::length(axis);
+			axis /= axisLength;
+
+			float c = cos(rotation[i]);
+			float s = sin(rotation[i]);
+			glm::mat3 rotate = c * glm::mat3(1.0f) + s * CrossMatrix(axis) + (1.0f - c) * glm::outerProduct(axis, axis);
+
+			for (int k = 0; k < 3; k++)
+			{
+				glm::vec3 axisDerivative = derivatives[k][i];
+				axisDerivative = (axisDerivative - axis * glm::dot(axis, axisDerivative)) / axisLength;
+
+				glm::mat3 rotateDerivative = s * CrossMatrix(axisDerivative) + (1.0f - c) * (glm::outerProduct(axisDerivative, axis) + glm::outerProduct(axis, axisDerivative));
+
+				if (k == i)
+					rotateDerivative += -s * glm::mat3(1.0f) + c * CrossMatrix(axis) + s * glm::outerProduct(axis, axis);
+
+				derivatives[k] = derivatives[k] * rotate + localRotation * rotateDerivative;
+			}
+
+			localRotation = localRotation * rotate;
+		}
+
+		for (int k = 0; k < 3; k++)
+		{
+			glm::mat3 w = derivatives[k] * glm::transpose(localRotation);
+			axes[k] = 0.5f * glm::vec3(w[1][2] - w[2][1], w[2][0] - w[0][2], w[0][1] - w[1][0]);
+		}
+	}
+
+private:
+	//matrix of cross product with v
+	static glm::mat3 CrossMatrix(const glm::vec3& v)
+	{
+		return glm::mat3(0.0f, v.z, -v.y, -v.z, 0.0f, v.x, v.y, -v.x, 0.0f);
+	}
+
+	glm::mat4 worldTransform; //cached result of CalcTransform, valid only when worldTransformDirty is false
+	bool worldTransformDirty;
+
+	//returns cached world transform, only bones changed since the last call (and their parents if needed) are recalculated
+	const glm::mat4& CalcTransform()
+	{
+		if (!worldTransformDirty)
+			return worldTransform;
+
+		if (parent != NULL)
+			worldTransform = parent->CalcTransform() * CalcLocalTransform(rotation, parent->boneLength);
+		else
+			worldTransform = InitialSceletonRotation();
+
+		worldTransformDirty = false;
+
+		return worldTransform;
+	}
+};
+
+#endif
\ No newline at end of file
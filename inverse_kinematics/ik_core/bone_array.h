@@ -0,0 +1,80 @@
+#ifndef BONE_ARRAY_HEADER
+#define BONE_ARRAY_HEADER
+
+#include <vector>
+#include <algorithm>
+
+//values of one bone property, one per bone of the skeleton, stored in the skeleton arena and placed there by the skeleton,
+//assignment copies values (both sides must have the same size), so it never makes two arrays share storage
+template<typename T>
+class BoneArray
+{
+public:
+	BoneArray()
+	{
+		data = NULL;
+		count = 0;
+	}
+
+	BoneArray& operator=(const BoneArray& values)
+	{
+		std::copy(values.begin(), values.end(), data);
+		return *this;
+	}
+
+	BoneArray& operator=(const std::vector<T>& values)
+	{
+		std::copy(values.begin(), values.end(), data);
+		return *this;
+	}
+
+	T& operator[](size_t index)
+	{
+		return data[index];
+	}
+
+	const T& operator[](size_t index) const
+	{
+		return data[index];
+	}
+
+	size_t size() const
+	{
+		return count;
+	}
+
+	bool empty() const
+	{
+		return count == 0;
+	}
+
+	T* begin()
+	{
+		return data;
+	}
+
+	T* end()
+	{
+		return data + count;
+	}
+
+	const T* begin() const
+	{
+		return data;
+	}
+
+	const T* end() const
+	{
+		return data + count;
+	}
+
+private:
+	friend class Skeleton;
+
+	T* data;
+	size_t count;
+
+	BoneArray(const BoneArray&) = delete;
+};
+
+#endif
@@ -0,0 +1,231 @@
+#ifndef CHAIN_HEADER
+#define CHAIN_HEADER
+
+#include "ik_solver.h"
+
+#define CHAIN_MAX_JOINTS 16 //longest chain ChainCCDSolver solves with a Chain, longer ones are left to the Skeleton
+
+//unbranched chain of N joints known at compile time, for rigs whose chain lengths are fixed, all state is in arrays
+//of constant size inside the object, so it can live on the stack, there is no indirection through bone indices
+//and loops over joints have constant bounds the compiler can unroll, bone 0 is the root, which is never rotated,
+//joint i is bone i, angles, constraints and the order of operations are the same as in Skeleton with Euler joints
+template<int N, typename Scalar = float>
+class Chain
+{
+public:
+	typedef glm::tvec3<Scalar> Vec3;
+	typedef glm::tvec4<Scalar> Vec4;
+	typedef glm::tmat4x4<Scalar> Mat4;
+	typedef glm::tquat<Scalar> Quat;
+
+	static const int JointsNum = N;
+	static const int BonesNum = N + 1;
+
+	Scalar boneLengths[BonesNum];
+	Vec3 rotations[BonesNum];
+	Vec3 constraintsMin[BonesNum];
+	Vec3 constraintsMax[BonesNum];
+	Mat4 worldTransforms[BonesNum];
+	Mat4 localTransforms[BonesNum]; //relatively to the parent bone, kept so bones below a rotated one are moved without trigonometry
+	Mat4 rootTransform;
+
+	Chain()
+	{
+		rootTransform = Mat4(InitialSceletonRotation());
+
+		for (int i = 0; i < BonesNum; i++)
+		{
+			boneLengths[i] = Scalar(0);
+			rotations[i] = Vec3(Scalar(0));
+			constraintsMin[i] = Vec3(Scalar(-360));
+			constraintsMax[i] = Vec3(Scalar(360));
+		}
+
+		CalcTransforms();
+	}
+
+	//copies the chain of the skeleton from its root to endEffectorIndex, returns false if it does not have N joints
+	bool Load(const Skeleton& skeleton, int endEffectorIndex)
+	{
+		int bones[BonesNum];
+		int count = 0;
+
+		for (int i = endEffectorIndex; i >= 0; i = skeleton.parentIndices[i], count++)
+			if (count < BonesNum)
+				bones[N - count] = i;
+
+		if (count != BonesNum)
+			return false;
+
+		for (int i = 0; i < BonesNum; i++)
+		{
+			boneLengths[i] = Scalar(skeleton.boneLengths[bones[i]]);
+			rotations[i] = Vec3(skeleton.rotations[bones[i]]);
+			constraintsMin[i] = Vec3(skeleton.constraintsMin[bones[i]]);
+			constraintsMax[i] = Vec3(skeleton.constraintsMax[bones[i]]);
+		}
+
+		rootTransform = Mat4(skeleton.rootTransform);
+		CalcTransforms();
+
+		return true;
+	}
+
+	//copies angles and world transforms back to the chain of the skeleton it was loaded from
+	void Store(Skeleton& skeleton, int endEffectorIndex) const
+	{
+		int c = N;
+
+		for (int i = endEffectorIndex; i >= 0 && c >= 0; i = skeleton.parentIndices[i], c--)
+		{
+			skeleton.rotations[i] = glm::vec3(rotations[c]);
+			skeleton.worldTransforms[i] = glm::mat4(worldTransforms[c]);
+		}
+	}
+
+	void SetRotate(int index, Scalar x, Scalar y, Scalar z)
+	{
+		rotations[index] = Vec3(fmod(x, Scalar(360)), fmod(y, Scalar(360)), fmod(z, Scalar(360)));
+	}
+
+	void CheckConstrainsAndMax(int index, Vec3 delta)
+	{
+		Vec3& rotation = rotations[index];
+
+		ClampAngleChanges(delta, rotation, constraintsMin[index], constraintsMax[index]);
+
+		SetRotate(index, rotation.x + delta.x, rotation.y + delta.y, rotation.z + delta.z);
+	}
+
+	void CalcTransforms()
+	{
+		localTransforms[0] = Mat4();
+		worldTransforms[0] = rootTransform;
+
+		for (int i = 1; i < BonesNum; i++)
+			CalcTransform(i);
+	}
+
+	//same as Skeleton::CalcTransform for a bone that is not the root
+	void CalcTransform(int index)
+	{
+		localTransforms[index] = CalcLocalTransform(rotations[index], boneLengths[index - 1]);
+		worldTransforms[index] = worldTransforms[index - 1] * localTransforms[index];
+	}
+
+	//same as Skeleton::GetBoneEnd, the translation is multiplied out, so only its column of the matrix is calculated
+	Vec3 GetBoneEnd(int index) const
+	{
+		const Mat4& t = worldTransforms[index];
+
+		return Vec3(t[2] * boneLengths[index] + t[3]);
+	}
+
+	//same as Skeleton::SolveCCD with the last bone as the end effector
+	bool SolveCCD(const Vec3& target, int maxIterations, Scalar epsilon, int* iterationsNum = NULL, std::vector<float>* residuals = NULL)
+	{
+		for (int i = 0; i < maxIterations; i++)
+		{
+			for (int c = N; c > 0; c--)
+			{
+				Vec3 startPosition = GetBoneEnd(c - 1);
+				Vec3 endPosition = GetBoneEnd(c);
+
+				Vec3 dirToTarget = glm::normalize(target - startPosition);
+				Vec3 dirToEndPos = glm::normalize(endPosition - startPosition);
+
+				if (glm::dot(dirToEndPos, dirToTarget) < Scalar(0.99f))
+				{
+					Scalar angle = glm::angle(dirToTarget, dirToEndPos);
+					Quat rotation = normalize(glm::angleAxis(angle, cross(dirToEndPos, dirToTarget)));
+					CheckConstrainsAndMax(c, glm::eulerAngles(rotation));
+
+					CalcTransform(c);
+
+					//angles of the bones below did not change, only their parent moved
+					for (int k = c + 1; k < BonesNum; k++)
+						worldTransforms[k] = worldTransforms[k - 1] * localTransforms[k];
+				}
+
+				Vec3 differnce = GetBoneEnd(N) - target;
+				Scalar squaredDistance = dot(differnce, differnce);
+
+				if (residuals != NULL && (c == 1 || squaredDistance < epsilon))
+					residuals->push_back((float)squaredDistance);
+
+				if (squaredDistance < epsilon)
+				{
+					if (iterationsNum != NULL)
+						*iterationsNum = i + 1;
+
+					return true;
+				}
+			}
+		}
+
+		if (iterationsNum != NULL)
+			*iterationsNum = maxIterations;
+
+		return false;
+	}
+
+private:
+	//same as Bone::CalcLocalTransform
+	static Mat4 CalcLocalTransform(const Vec3& rotation, Scalar parentLength)
+	{
+		Mat4 localTransform = glm::translate(Mat4(), Vec3(Scalar(0), Scalar(0), parentLength));
+		localTransform = glm::rotate(localTransform, rotation.x, Vec3(localTransform * Vec4(Scalar(1), Scalar(0), Scalar(0), Scalar(0))));
+		localTransform = glm::rotate(localTransform, rotation.y, Vec3(localTransform * Vec4(Scalar(0), Scalar(1), Scalar(0), Scalar(0))));
+		localTransform = glm::rotate(localTransform, rotation.z, Vec3(localTransform * Vec4(Scalar(0), Scalar(0), Scalar(1), Scalar(0))));
+
+		return localTransform;
+	}
+};
+
+//solves the skeleton chain in a Chain<N> if N is the number of its joints, tries the next N otherwise
+template<int N>
+struct ChainCCD
+{
+	static bool Solve(int jointsNum, Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target, int maxIterations, float epsilon, int* iterationsNum, std::vector<float>* residuals)
+	{
+		if (jointsNum != N)
+			return ChainCCD<N + 1>::Solve(jointsNum, skeleton, endEffectorIndex, target, maxIterations, epsilon, iterationsNum, residuals);
+
+		Chain<N> chain;
+		chain.Load(skeleton, endEffectorIndex);
+		bool reached = chain.SolveCCD(target, maxIterations, epsilon, iterationsNum, residuals);
+		chain.Store(skeleton, endEffectorIndex);
+
+		return reached;
+	}
+};
+
+template<>
+struct ChainCCD<CHAIN_MAX_JOINTS + 1>
+{
+	static bool Solve(int, Skeleton&, int, const glm::vec3&, int, float, int*, std::vector<float>*)
+	{
+		return false;
+	}
+};
+
+//CCD on a Chain of the length of the solved chain, ends in the same pose as CCDSolver, skeletons with quaternion joints
+//and chains longer than CHAIN_MAX_JOINTS are solved by Skeleton::SolveCCD
+class ChainCCDSolver : public IKSolver
+{
+public:
+	bool Solve(Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target, int maxIterations, float epsilon)
+	{
+		int jointsNum = -1;
+
+		for (int i = endEffectorIndex; i >= 0; i = skeleton.parentIndices[i])
+			jointsNum++;
+
+		if (skeleton.quaternionJoints || jointsNum < 1 || jointsNum > CHAIN_MAX_JOINTS)
+			return skeleton.SolveCCD(endEffectorIndex, target, maxIterations, epsilon, &iterationsNum, residuals);
+
+		return ChainCCD<1>::Solve(jointsNum, skeleton, endEffectorIndex, target, maxIterations, epsilon, &iterationsNum, residuals);
+	}
+};
+
+#endif
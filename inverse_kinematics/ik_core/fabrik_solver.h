@@ -0,0 +1,77 @@
+#ifndef FABRIK_SOLVER_HEADER
+#define FABRIK_SOLVER_HEADER
+
+#include "ik_solver.h"
+
+//forward and backward reaching IK, joint positions are moved along the chain first and then
+//bone angles are fitted to them, so every iteration starts from a pose that respects constraints
+class FABRIKSolver : public IKSolver
+{
+public:
+	bool Solve(Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target, int maxIterations, float epsilon)
+	{
+		skeleton.GetChain(endEffectorIndex, chain);
+		positions.resize(chain.size());
+
+		for (size_t c = 0; c < chain.size(); c++)
+			skeleton.CalcTransform(chain[c]);
+
+		//root bone is never rotated so its end is the fixed base of the chain
+		glm::vec3 base = glm::vec3(skeleton.GetBoneEnd(chain[0]));
+		float chainLength = 0.0f;
+
+		for (size_t c = 1; c < chain.size(); c++)
+			chainLength += skeleton.boneLengths[chain[c]];
+
+		for (iterationsNum = 0; iterationsNum < maxIterations; iterationsNum++)
+		{
+			for (size_t c = 0; c < chain.size(); c++)
+				positions[c] = glm::vec3(skeleton.GetBoneEnd(chain[c]));
+
+			glm::vec3 differnce = positions.back() - target;
+
+			if (dot(differnce, differnce) < epsilon)
+				return true;
+
+			bool reachable = glm::length(target - base) < chainLength;
+
+			if (reachable)
+			{
+				//backward pass from the target
+				positions.back() = target;
+
+				for (int c = (int)chain.size() - 2; c >= 0; c--)
+					positions[c] = positions[c + 1] + glm::normalize(positions[c] - positions[c + 1]) * skeleton.boneLengths[chain[c + 1]];
+
+				//forward pass from the base
+				positions[0] = base;
+			}
+
+			for (size_t c = 1; c < chain.size(); c++)
+			{
+				glm::vec3 direction = reachable ? positions[c] - positions[c - 1] : target - base;
+				positions[c] = positions[c - 1] + glm::normalize(direction) * skeleton.boneLengths[chain[c]];
+			}
+
+			for (size_t c = 1; c < chain.size(); c++)
+				skeleton.RotateTowards(chain[c], positions[c]);
+
+			TraceResidual(skeleton, endEffectorIndex, target);
+
+			//straight chain is the best pose for the target out of reach
+			if (!reachable)
+			{
+				iterationsNum++;
+				return false;
+			}
+		}
+
+		return false;
+	}
+
+private:
+	std::vector<int> chain;
+	std::vector<glm::vec3> positions;
+};
+
+#endif
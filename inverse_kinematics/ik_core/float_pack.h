@@ -0,0 +1,369 @@
+#ifndef FLOAT_PACK_HEADER
+#define FLOAT_PACK_HEADER
+
+#include <math.h>
+#include <stdlib.h>
+#include <new>
+
+#if defined(__AVX__)
+#define IK_SIMD_AVX 1
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define IK_SIMD_SSE 1
+#endif
+
+#if IK_SIMD_AVX || IK_SIMD_SSE
+#include <immintrin.h>
+#endif
+
+//verification build option, with 1 the C library trigonometry is used lane by lane and lockstep results are the same
+//as the scalar ones as long as the compiler does not fuse multiplications and additions (-ffp-contract=off for GCC
+//and Clang with FMA enabled), by default the packed approximations are used, they differ only in the last bits
+#ifndef IK_SIMD_EXACT_TRIG
+#define IK_SIMD_EXACT_TRIG 0
+#endif
+
+//widest pack supported by the instruction set the code is compiled for
+#if IK_SIMD_AVX
+#define IK_SIMD_WIDTH 8
+#else
+#define IK_SIMD_WIDTH 4
+#endif
+
+//W floats processed together, this generic version is the scalar fallback,
+//SSE and AVX versions below are used for 4 and 8 lanes when available
+template<int W>
+struct MaskPack
+{
+	bool v[W];
+
+	bool Lane(int i) const { return v[i]; }
+};
+
+template<int W>
+struct FloatPack
+{
+	static const int Width = W;
+	typedef MaskPack<W> Mask;
+
+	float v[W];
+
+	FloatPack() {}
+	FloatPack(float f) { for (int i = 0; i < W; i++) v[i] = f; }
+
+	static FloatPack Load(const float* f) { FloatPack r; for (int i = 0; i < W; i++) r.v[i] = f[i]; return r; }
+	void Store(float* f) const { for (int i = 0; i < W; i++) f[i] = v[i]; }
+
+	static Mask MakeMask(const bool* b) { Mask r; for (int i = 0; i < W; i++) r.v[i] = b[i]; return r; }
+};
+
+template<int W> inline FloatPack<W> operator+(const FloatPack<W>& a, const FloatPack<W>& b) { FloatPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] + b.v[i]; return r; }
+template<int W> inline FloatPack<W> operator-(const FloatPack<W>& a, const FloatPack<W>& b) { FloatPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] - b.v[i]; return r; }
+template<int W> inline FloatPack<W> operator*(const FloatPack<W>& a, const FloatPack<W>& b) { FloatPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] * b.v[i]; return r; }
+template<int W> inline FloatPack<W> operator/(const FloatPack<W>& a, const FloatPack<W>& b) { FloatPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] / b.v[i]; return r; }
+template<int W> inline FloatPack<W> Sqrt(const FloatPack<W>& a) { FloatPack<W> r; for (int i = 0; i < W; i++) r.v[i] = sqrtf(a.v[i]); return r; }
+template<int W> inline FloatPack<W> Min(const FloatPack<W>& a, const FloatPack<W>& b) { FloatPack<W> r; for (int i = 0; i < W; i++) r.v[i] = b.v[i] < a.v[i] ? b.v[i] : a.v[i]; return r; }
+template<int W> inline FloatPack<W> Max(const FloatPack<W>& a, const FloatPack<W>& b) { FloatPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] < b.v[i] ? b.v[i] : a.v[i]; return r; }
+template<int W> inline FloatPack<W> Floor(const FloatPack<W>& a) { FloatPack<W> r; for (int i = 0; i < W; i++) r.v[i] = floorf(a.v[i]); return r; }
+template<int W> inline MaskPack<W> Less(const FloatPack<W>& a, const FloatPack<W>& b) { MaskPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] < b.v[i]; return r; }
+template<int W> inline MaskPack<W> Greater(const FloatPack<W>& a, const FloatPack<W>& b) { MaskPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] > b.v[i]; return r; }
+template<int W> inline FloatPack<W> Select(const MaskPack<W>& m, const FloatPack<W>& a, const FloatPack<W>& b) { FloatPack<W> r; for (int i = 0; i < W; i++) r.v[i] = m.v[i] ? a.v[i] : b.v[i]; return r; }
+template<int W> inline MaskPack<W> operator&(const MaskPack<W>& a, const MaskPack<W>& b) { MaskPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] && b.v[i]; return r; }
+template<int W> inline MaskPack<W> operator|(const MaskPack<W>& a, const MaskPack<W>& b) { MaskPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] || b.v[i]; return r; }
+template<int W> inline MaskPack<W> AndNot(const MaskPack<W>& a, const MaskPack<W>& b) { MaskPack<W> r; for (int i = 0; i < W; i++) r.v[i] = a.v[i] && !b.v[i]; return r; }
+template<int W> inline bool Any(const MaskPack<W>& m) { for (int i = 0; i < W; i++) if (m.v[i]) return true; return false; }
+
+#if IK_SIMD_SSE
+template<>
+struct MaskPack<4>
+{
+	__m128 v;
+
+	bool Lane(int i) const { return ((_mm_movemask_ps(v) >> i) & 1) != 0; }
+};
+
+template<>
+struct FloatPack<4>
+{
+	static const int Width = 4;
+	typedef MaskPack<4> Mask;
+
+	__m128 v;
+
+	FloatPack() {}
+	FloatPack(float f) { v = _mm_set1_ps(f); }
+	FloatPack(__m128 m) { v = m; }
+
+	static FloatPack Load(const float* f) { return FloatPack(_mm_loadu_ps(f)); }
+	void Store(float* f) const { _mm_storeu_ps(f, v); }
+
+	static Mask MakeMask(const bool* b) { Mask r; r.v = _mm_castsi128_ps(_mm_setr_epi32(-(int)b[0], -(int)b[1], -(int)b[2], -(int)b[3])); return r; }
+};
+
+inline FloatPack<4> operator+(const FloatPack<4>& a, const FloatPack<4>& b) { return _mm_add_ps(a.v, b.v); }
+inline FloatPack<4> operator-(const FloatPack<4>& a, const FloatPack<4>& b) { return _mm_sub_ps(a.v, b.v); }
+inline FloatPack<4> operator*(const FloatPack<4>& a, const FloatPack<4>& b) { return _mm_mul_ps(a.v, b.v); }
+inline FloatPack<4> operator/(const FloatPack<4>& a, const FloatPack<4>& b) { return _mm_div_ps(a.v, b.v); }
+inline FloatPack<4> Sqrt(const FloatPack<4>& a) { return _mm_sqrt_ps(a.v); }
+inline FloatPack<4> Min(const FloatPack<4>& a, const FloatPack<4>& b) { return _mm_min_ps(a.v, b.v); }
+inline FloatPack<4> Max(const FloatPack<4>& a, const FloatPack<4>& b) { return _mm_max_ps(a.v, b.v); }
+inline FloatPack<4> Floor(const FloatPack<4>& a)
+{
+	//SSE2 has no floor instruction, truncation is corrected for negative values
+	__m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a.v));
+	return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a.v), _mm_set1_ps(1.0f)));
+}
+inline MaskPack<4> Less(const FloatPack<4>& a, const FloatPack<4>& b) { MaskPack<4> r; r.v = _mm_cmplt_ps(a.v, b.v); return r; }
+inline MaskPack<4> Greater(const FloatPack<4>& a, const FloatPack<4>& b) { MaskPack<4> r; r.v = _mm_cmpgt_ps(a.v, b.v); return r; }
+inline FloatPack<4> Select(const MaskPack<4>& m, const FloatPack<4>& a, const FloatPack<4>& b) { return _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v)); }
+inline MaskPack<4> operator&(const MaskPack<4>& a, const MaskPack<4>& b) { MaskPack<4> r; r.v = _mm_and_ps(a.v, b.v); return r; }
+inline MaskPack<4> operator|(const MaskPack<4>& a, const MaskPack<4>& b) { MaskPack<4> r; r.v = _mm_or_ps(a.v, b.v); return r; }
+inline MaskPack<4> AndNot(const MaskPack<4>& a, const MaskPack<4>& b) { MaskPack<4> r; r.v = _mm_andnot_ps(b.v, a.v); return r; }
+inline bool Any(const MaskPack<4>& m) { return _mm_movemask_ps(m.v) != 0; }
+#endif
+
+//four lanes from separate values, without going through memory when SSE is available
+#if IK_SIMD_SSE
+inline FloatPack<4> MakePack(float a, float b, float c, float d) { return _mm_setr_ps(a, b, c, d); }
+#else
+inline FloatPack<4> MakePack(float a, float b, float c, float d) { float f[4] = { a, b, c, d }; return FloatPack<4>::Load(f); }
+#endif
+
+//single double lane, so code written for packs also works on plain values
+inline bool Less(double a, double b) { return a < b; }
+inline bool Greater(double a, double b) { return a > b; }
+inline double Select(bool m, double a, double b) { return m ? a : b; }
+
+#if IK_SIMD_AVX
+template<>
+struct MaskPack<8>
+{
+	__m256 v;
+
+	bool Lane(int i) const { return ((_mm256_movemask_ps(v) >> i) & 1) != 0; }
+};
+
+template<>
+struct FloatPack<8>
+{
+	static const int Width = 8;
+	typedef MaskPack<8> Mask;
+
+	__m256 v;
+
+	FloatPack() {}
+	FloatPack(float f) { v = _mm256_set1_ps(f); }
+	FloatPack(__m256 m) { v = m; }
+
+	static FloatPack Load(const float* f) { return FloatPack(_mm256_loadu_ps(f)); }
+	void Store(float* f) const { _mm256_storeu_ps(f, v); }
+
+	static Mask MakeMask(const bool* b)
+	{
+		Mask r;
+		r.v = _mm256_castsi256_ps(_mm256_setr_epi32(-(int)b[0], -(int)b[1], -(int)b[2], -(int)b[3], -(int)b[4], -(int)b[5], -(int)b[6], -(int)b[7]));
+		return r;
+	}
+};
+
+inline FloatPack<8> operator+(const FloatPack<8>& a, const FloatPack<8>& b) { return _mm256_add_ps(a.v, b.v); }
+inline FloatPack<8> operator-(const FloatPack<8>& a, const FloatPack<8>& b) { return _mm256_sub_ps(a.v, b.v); }
+inline FloatPack<8> operator*(const FloatPack<8>& a, const FloatPack<8>& b) { return _mm256_mul_ps(a.v, b.v); }
+inline FloatPack<8> operator/(const FloatPack<8>& a, const FloatPack<8>& b) { return _mm256_div_ps(a.v, b.v); }
+inline FloatPack<8> Sqrt(const FloatPack<8>& a) { return _mm256_sqrt_ps(a.v); }
+inline FloatPack<8> Min(const FloatPack<8>& a, const FloatPack<8>& b) { return _mm256_min_ps(a.v, b.v); }
+inline FloatPack<8> Max(const FloatPack<8>& a, const FloatPack<8>& b) { return _mm256_max_ps(a.v, b.v); }
+inline FloatPack<8> Floor(const FloatPack<8>& a) { return _mm256_floor_ps(a.v); }
+inline MaskPack<8> Less(const FloatPack<8>& a, const FloatPack<8>& b) { MaskPack<8> r; r.v = _mm256_cmp_ps(a.v, b.v, _CMP_LT_OQ); return r; }
+inline MaskPack<8> Greater(const FloatPack<8>& a, const FloatPack<8>& b) { MaskPack<8> r; r.v = _mm256_cmp_ps(a.v, b.v, _CMP_GT_OQ); return r; }
+inline FloatPack<8> Select(const MaskPack<8>& m, const FloatPack<8>& a, const FloatPack<8>& b) { return _mm256_blendv_ps(b.v, a.v, m.v); }
+inline MaskPack<8> operator&(const MaskPack<8>& a, const MaskPack<8>& b) { MaskPack<8> r; r.v = _mm256_and_ps(a.v, b.v); return r; }
+inline MaskPack<8> operator|(const MaskPack<8>& a, const MaskPack<8>& b) { MaskPack<8> r; r.v = _mm256_or_ps(a.v, b.v); return r; }
+inline MaskPack<8> AndNot(const MaskPack<8>& a, const MaskPack<8>& b) { MaskPack<8> r; r.v = _mm256_andnot_ps(b.v, a.v); return r; }
+inline bool Any(const MaskPack<8>& m) { return _mm256_movemask_ps(m.v) != 0; }
+#endif
+
+//std::allocator before C++17 ignores alignment of types above the one of malloc, so vectors of packs use this one
+template<typename T>
+struct PackAllocator
+{
+	typedef T value_type;
+
+	PackAllocator() {}
+	template<typename U> PackAllocator(const PackAllocator<U>&) {}
+
+	T* allocate(size_t n)
+	{
+#if IK_SIMD_AVX || IK_SIMD_SSE
+		void* p = _mm_malloc(n * sizeof(T), alignof(T));
+#else
+		void* p = malloc(n * sizeof(T));
+#endif
+		if (p == NULL)
+			throw std::bad_alloc();
+
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t)
+	{
+#if IK_SIMD_AVX || IK_SIMD_SSE
+		_mm_free(p);
+#else
+		free(p);
+#endif
+	}
+};
+
+template<typename T, typename U> inline bool operator==(const PackAllocator<T>&, const PackAllocator<U>&) { return true; }
+template<typename T, typename U> inline bool operator!=(const PackAllocator<T>&, const PackAllocator<U>&) { return false; }
+
+//functions without packed instructions (trigonometry, fmod) are evaluated lane by lane
+template<class Pack, class Func>
+inline Pack Map(const Pack& a, Func func)
+{
+	float f[Pack::Width];
+	a.Store(f);
+
+	for (int i = 0; i < Pack::Width; i++)
+		f[i] = func(f[i]);
+
+	return Pack::Load(f);
+}
+
+template<class Pack, class Func>
+inline Pack Map(const Pack& a, const Pack& b, Func func)
+{
+	float fa[Pack::Width];
+	float fb[Pack::Width];
+	a.Store(fa);
+	b.Store(fb);
+
+	for (int i = 0; i < Pack::Width; i++)
+		fa[i] = func(fa[i], fb[i]);
+
+	return Pack::Load(fa);
+}
+
+template<class Pack>
+inline Pack Clamp(const Pack& a, float minValue, float maxValue)
+{
+	return Min(Max(a, Pack(minValue)), Pack(maxValue));
+}
+
+template<class Pack>
+inline Pack Abs(const Pack& a)
+{
+	return Max(a, Pack(0.0f) - a);
+}
+
+#if IK_SIMD_EXACT_TRIG
+//C library trigonometry lane by lane, slower but gives exactly the same results as the scalar code
+template<class Pack>
+inline void SinCos(const Pack& a, Pack& sinResult, Pack& cosResult)
+{
+	sinResult = Map(a, sinf);
+	cosResult = Map(a, cosf);
+}
+
+template<class Pack> inline Pack Asin(const Pack& a) { return Map(a, asinf); }
+template<class Pack> inline Pack Acos(const Pack& a) { return Map(a, acosf); }
+template<class Pack> inline Pack Atan2(const Pack& y, const Pack& x) { return Map(y, x, atan2f); }
+#else
+//trigonometry below uses the single precision Cephes approximations, so every lane is computed with the same
+//packed instructions, results differ from the C library only in the last bits
+
+template<class Pack>
+inline void SinCos(const Pack& a, Pack& sinResult, Pack& cosResult)
+{
+	Pack x = Abs(a);
+
+	//octant of the angle, rounded up to even
+	Pack j = Floor(x * Pack(1.27323954473516f));
+	j = j + (j - Pack(2.0f) * Floor(j * Pack(0.5f)));
+
+	x = ((x - j * Pack(0.78515625f)) - j * Pack(2.4187564849853515625e-4f)) - j * Pack(3.77489497744594108e-8f);
+	j = j - Pack(8.0f) * Floor(j * Pack(0.125f));
+
+	typename Pack::Mask upperHalf = Greater(j, Pack(3.0f));
+	j = Select(upperHalf, j - Pack(4.0f), j);
+
+	typename Pack::Mask swap = Greater(j, Pack(0.0f)) & Less(j, Pack(3.0f));
+	typename Pack::Mask sinNegative = Less(a, Pack(0.0f));
+	sinNegative = AndNot(sinNegative | upperHalf, sinNegative & upperHalf);
+	typename Pack::Mask cosNegative = Greater(j, Pack(1.0f));
+	cosNegative = AndNot(cosNegative | upperHalf, cosNegative & upperHalf);
+
+	Pack z = x * x;
+	Pack sinPoly = ((Pack(-1.9515295891e-4f) * z + Pack(8.3321608736e-3f)) * z - Pack(1.6666654611e-1f)) * z * x + x;
+	Pack cosPoly = ((Pack(2.443315711809948e-5f) * z - Pack(1.388731625493765e-3f)) * z + Pack(4.166664568298827e-2f)) * z * z - Pack(0.5f) * z + Pack(1.0f);
+
+	sinResult = Select(swap, cosPoly, sinPoly);
+	cosResult = Select(swap, sinPoly, cosPoly);
+	sinResult = Select(sinNegative, Pack(0.0f) - sinResult, sinResult);
+	cosResult = Select(cosNegative, Pack(0.0f) - cosResult, cosResult);
+}
+
+//arcsine for |a| <= 0.5
+template<class Pack>
+inline Pack AsinSmall(const Pack& a)
+{
+	Pack z = a * a;
+	return ((((Pack(4.2163199048e-2f) * z + Pack(2.4181311049e-2f)) * z + Pack(4.5470025998e-2f)) * z + Pack(7.4953002686e-2f)) * z + Pack(1.6666752422e-1f)) * z * a + a;
+}
+
+template<class Pack>
+inline Pack Asin(const Pack& a)
+{
+	Pack x = Abs(a);
+	typename Pack::Mask large = Greater(x, Pack(0.5f));
+
+	Pack small = AsinSmall(Select(large, Sqrt(Pack(0.5f) * (Pack(1.0f) - x)), x));
+	Pack result = Select(large, Pack(1.5707963267948966f) - (small + small), small);
+
+	return Select(Less(a, Pack(0.0f)), Pack(0.0f) - result, result);
+}
+
+template<class Pack>
+inline Pack Acos(const Pack& a)
+{
+	typename Pack::Mask upper = Greater(a, Pack(0.5f));
+	typename Pack::Mask lower = Less(a, Pack(-0.5f));
+
+	Pack small = AsinSmall(Select(upper, Sqrt(Pack(0.5f) * (Pack(1.0f) - a)), Select(lower, Sqrt(Pack(0.5f) * (Pack(1.0f) + a)), a)));
+
+	return Select(upper, small + small, Select(lower, Pack(3.14159265358979f) - (small + small), Pack(1.5707963267948966f) - small));
+}
+
+template<class Pack>
+inline Pack Atan(const Pack& a)
+{
+	Pack x = Abs(a);
+	typename Pack::Mask large = Greater(x, Pack(2.414213562373095f));
+	typename Pack::Mask medium = AndNot(Greater(x, Pack(0.4142135623730950f)), large);
+
+	Pack offset = Select(large, Pack(1.5707963267948966f), Select(medium, Pack(0.7853981633974483f), Pack(0.0f)));
+	x = Select(large, Pack(-1.0f) / x, Select(medium, (x - Pack(1.0f)) / (x + Pack(1.0f)), x));
+
+	Pack z = x * x;
+	Pack result = offset + (((Pack(8.05374449538e-2f) * z - Pack(1.38776856032e-1f)) * z + Pack(1.99777106478e-1f)) * z - Pack(3.33329491539e-1f)) * z * x + x;
+
+	return Select(Less(a, Pack(0.0f)), Pack(0.0f) - result, result);
+}
+
+template<class Pack>
+inline Pack Atan2(const Pack& y, const Pack& x)
+{
+	Pack result = Atan(y / x);
+
+	//x < 0 moves the angle to the opposite half plane
+	Pack halfTurn = Select(Less(y, Pack(0.0f)), Pack(-3.14159265358979f), Pack(3.14159265358979f));
+	result = Select(Less(x, Pack(0.0f)), result + halfTurn, result);
+
+	//atan2(0, 0) is 0 as in the C library
+	return Select(Less(Abs(x) + Abs(y), Pack(1e-30f)), Pack(0.0f), result);
+}
+#endif
+
+#endif
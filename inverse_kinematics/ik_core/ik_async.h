@@ -0,0 +1,173 @@
+#ifndef IK_ASYNC_HEADER
+#define IK_ASYNC_HEADER
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "ik_core.h"
+#include "triple_buffer.h"
+
+//solver state handed to the renderer
+struct IKPose
+{
+	std::vector<glm::vec3> rotations;
+	std::vector<glm::quat> orientations;
+	std::vector<glm::mat4> worldTransforms;
+	glm::vec3 target;
+	IKSolveResult result; //progress on the target so far in tracking mode
+	unsigned int version; //grows with every published pose
+};
+
+//runs IK on its own thread with a private copy of the context, requests are posted without waiting for solving
+//and poses are published through a triple buffer, so neither the renderer nor the solver ever waits for the other
+class IKAsyncSolver
+{
+public:
+	IKAsyncSolver()
+	{
+		stop = false;
+		requestId = 0;
+		posesNum = 0;
+	}
+
+	~IKAsyncSolver()
+	{
+		if (!worker.joinable())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+
+		requestPosted.notify_one();
+		worker.join();
+	}
+
+	//copies the context (skeleton, settings and cache) and starts the solver thread
+	void Start(const IKContext& context)
+	{
+		this->context = context;
+		worker = std::thread(&IKAsyncSolver::WorkerLoop, this);
+	}
+
+	//replaces the pending request, the solver starts from the pose it reached on the previous one, tracking requests are solved
+	//in slices of TRACKING_BUDGET_US with a pose published after each one and the next request interrupts them between slices,
+	//other requests are solved with IKContext::Solve at once
+	void Solve(IKSolverType type, const glm::vec3& target, int maxIterations, bool tracking = false)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+
+			//tracking posts the same request every frame while the target does not move
+			if (tracking && requestId != 0 && type == request.type && target == request.target && maxIterations == request.maxIterations && tracking == request.tracking)
+				return;
+
+			request.type = type;
+			request.target = target;
+			request.maxIterations = maxIterations;
+			request.tracking = tracking;
+			requestId++;
+		}
+
+		requestPosted.notify_one();
+	}
+
+	//renderer side, copies the last published pose into the skeleton if there is a new one, returns true if it was copied
+	bool AcquirePose(Skeleton& skeleton)
+	{
+		if (!poses.Update())
+			return false;
+
+		const IKPose& pose = poses.Front();
+		skeleton.rotations = pose.rotations;
+		skeleton.orientations = pose.orientations;
+		skeleton.worldTransforms = pose.worldTransforms;
+
+		return true;
+	}
+
+	//last pose taken by AcquirePose, empty before the first one
+	const IKPose& Pose() const
+	{
+		return poses.Front();
+	}
+
+private:
+	struct Request
+	{
+		IKSolverType type;
+		glm::vec3 target;
+		int maxIterations;
+		bool tracking;
+	};
+
+	IKContext context; //used only by the solver thread
+	TripleBuffer<IKPose> poses;
+	unsigned int posesNum;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable requestPosted;
+	Request request;
+	unsigned int requestId;
+	bool stop;
+
+	void WorkerLoop()
+	{
+		unsigned int handledRequestId = 0;
+		bool solving = false;
+		Request current;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				requestPosted.wait(lock, [this, handledRequestId, solving] { return stop || requestId != handledRequestId || solving; });
+
+				if (stop)
+					return;
+
+				if (requestId != handledRequestId)
+				{
+					current = request;
+					handledRequestId = requestId;
+				}
+			}
+
+			context.target = current.target;
+
+			if (current.tracking)
+			{
+				context.Track(current.type, current.maxIterations, TRACKING_BUDGET_US);
+				solving = !context.tracker.converged && context.tracker.iterationsNum < current.maxIterations;
+			}
+			else
+			{
+				context.Solve(current.type, current.maxIterations);
+				solving = false;
+			}
+
+			Publish();
+		}
+	}
+
+	void Publish()
+	{
+		//solvers update transforms of the solved chain only
+		context.skeleton.CalcTransforms();
+
+		IKPose& pose = poses.Back();
+		const Skeleton& skeleton = context.skeleton;
+		pose.rotations.assign(skeleton.rotations.begin(), skeleton.rotations.end());
+		pose.orientations.assign(skeleton.orientations.begin(), skeleton.orientations.end());
+		pose.worldTransforms.assign(skeleton.worldTransforms.begin(), skeleton.worldTransforms.end());
+		pose.target = context.target;
+		pose.result = context.result;
+		pose.version = ++posesNum;
+
+		poses.Publish();
+	}
+};
+
+#endif
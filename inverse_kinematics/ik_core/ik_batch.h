@@ -0,0 +1,46 @@
+#ifndef IK_BATCH_HEADER
+#define IK_BATCH_HEADER
+
+#include "skeleton.h"
+#include "skeleton_pack.h"
+#include "thread_pool.h"
+
+//solves count independent chains, i-th skeleton is rotated so that bone endEffectorIndices[i] reaches targets[i],
+//converged[i] receives true if the target was reached within epsilon
+inline void SolveCCDBatch(Skeleton* skeletons, const int* endEffectorIndices, const glm::vec3* targets, bool* converged,
+	int count, int maxIterations, float epsilon, ThreadPool& pool)
+{
+	pool.ParallelFor(count, [=](int i)
+	{
+		converged[i] = skeletons[i].SolveCCD(endEffectorIndices[i], targets[i], maxIterations, epsilon);
+	});
+}
+
+//same as SolveCCDBatch for skeletons of the same topology, every pool item solves IK_SIMD_WIDTH chains in lockstep,
+//packs with quaternion joints are solved one skeleton after another
+inline void SolveCCDBatchLockstep(Skeleton* skeletons, int endEffectorIndex, const glm::vec3* targets, bool* converged,
+	int count, int maxIterations, float epsilon, ThreadPool& pool)
+{
+	int packsNum = (count + IK_SIMD_WIDTH - 1) / IK_SIMD_WIDTH;
+
+	pool.ParallelFor(packsNum, [=](int i)
+	{
+		int first = i * IK_SIMD_WIDTH;
+		int lanesNum = std::min(IK_SIMD_WIDTH, count - first);
+
+		SkeletonPack<IK_SIMD_WIDTH> pack;
+
+		if (!pack.Load(skeletons + first, lanesNum))
+		{
+			for (int l = first; l < first + lanesNum; l++)
+				converged[l] = skeletons[l].SolveCCD(endEffectorIndex, targets[l], maxIterations, epsilon);
+
+			return;
+		}
+
+		pack.SolveCCD(endEffectorIndex, targets + first, maxIterations, epsilon, converged + first);
+		pack.Store(skeletons + first);
+	});
+}
+
+#endif
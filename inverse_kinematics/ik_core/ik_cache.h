@@ -0,0 +1,155 @@
+#ifndef IK_CACHE_HEADER
+#define IK_CACHE_HEADER
+
+#include <vector>
+#include "skeleton.h"
+
+#define CACHE_CELL_SIZE 0.1f
+
+//converged poses of one skeleton stored in a grid over the target workspace, every cell keeps the last pose
+//that reached a target inside it, solves for nearby targets start from that pose instead of the current one
+class IKWarmStartCache
+{
+public:
+	int hitsNum;
+	int missesNum;
+
+	IKWarmStartCache(const glm::vec3& workspaceMin, const glm::vec3& workspaceMax, float cellSize = CACHE_CELL_SIZE)
+	{
+		this->workspaceMin = workspaceMin;
+		this->cellSize = cellSize;
+		cellsNum = glm::max(glm::ivec3(glm::ceil((workspaceMax - workspaceMin) / cellSize)), glm::ivec3(1));
+		cellEntries.assign(cellsNum.x * cellsNum.y * cellsNum.z, -1);
+		bonesNum = 0;
+		hitsNum = 0;
+		missesNum = 0;
+	}
+
+	void Clear()
+	{
+		cellEntries.assign(cellEntries.size(), -1);
+		entryTargets.clear();
+		entryRotations.clear();
+		entryOrientations.clear();
+		hitsNum = 0;
+		missesNum = 0;
+	}
+
+	//remembers the current pose as the solution for the target, targets outside of the workspace are not stored
+	void Store(const Skeleton& skeleton, const glm::vec3& target)
+	{
+		int cell = GetCell(target);
+
+		if (cell < 0)
+			return;
+
+		//poses cached for a skeleton with another number of bones do not fit this one, the cache starts over
+		if (!entryTargets.empty() && skeleton.Size() != bonesNum)
+			Clear();
+
+		if (entryTargets.empty())
+			bonesNum = skeleton.Size();
+
+		int entry = cellEntries[cell];
+
+		if (entry < 0)
+		{
+			entry = cellEntries[cell] = (int)entryTargets.size();
+			entryTargets.push_back(target);
+			entryRotations.resize(entryRotations.size() + bonesNum);
+			entryOrientations.resize(entryOrientations.size() + bonesNum);
+		}
+
+		entryTargets[entry] = target;
+		std::copy(skeleton.rotations.begin(), skeleton.rotations.end(), entryRotations.begin() + entry * bonesNum);
+		std::copy(skeleton.orientations.begin(), skeleton.orientations.end(), entryOrientations.begin() + entry * bonesNum);
+	}
+
+	//loads the pose of the nearest cached target from the cell of the target and its neighbours,
+	//the pose is used only if its target is closer than the current end effector position, returns true if it was loaded
+	bool Seed(Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target)
+	{
+		int entry = FindNearest(target);
+
+		if (entry < 0 || skeleton.Size() != bonesNum)
+		{
+			missesNum++;
+			return false;
+		}
+
+		glm::vec3 cachedDifference = entryTargets[entry] - target;
+		glm::vec3 currentDifference = glm::vec3(skeleton.GetBoneEnd(endEffectorIndex)) - target;
+
+		if (glm::dot(cachedDifference, cachedDifference) >= glm::dot(currentDifference, currentDifference))
+		{
+			missesNum++;
+			return false;
+		}
+
+		std::copy(entryRotations.begin() + entry * bonesNum, entryRotations.begin() + (entry + 1) * bonesNum, skeleton.rotations.begin());
+		std::copy(entryOrientations.begin() + entry * bonesNum, entryOrientations.begin() + (entry + 1) * bonesNum, skeleton.orientations.begin());
+		skeleton.CalcTransforms();
+		hitsNum++;
+
+		return true;
+	}
+
+private:
+	glm::vec3 workspaceMin;
+	float cellSize;
+	glm::ivec3 cellsNum;
+	int bonesNum;
+
+	std::vector<int> cellEntries; //-1 for empty cells
+	std::vector<glm::vec3> entryTargets;
+	std::vector<glm::vec3> entryRotations; //bonesNum values per entry
+	std::vector<glm::quat> entryOrientations;
+
+	glm::ivec3 Quantize(const glm::vec3& target) const
+	{
+		return glm::ivec3(glm::floor((target - workspaceMin) / cellSize));
+	}
+
+	int GetCell(const glm::ivec3& c) const
+	{
+		if (glm::any(glm::lessThan(c, glm::ivec3(0))) || glm::any(glm::greaterThanEqual(c, cellsNum)))
+			return -1;
+
+		return (c.z * cellsNum.y + c.y) * cellsNum.x + c.x;
+	}
+
+	int GetCell(const glm::vec3& target) const
+	{
+		return GetCell(Quantize(target));
+	}
+
+	int FindNearest(const glm::vec3& target) const
+	{
+		glm::ivec3 center = Quantize(target);
+		int nearest = -1;
+		float nearestDistance = 0.0f;
+
+		for (int z = -1; z <= 1; z++)
+			for (int y = -1; y <= 1; y++)
+				for (int x = -1; x <= 1; x++)
+				{
+					int cell = GetCell(center + glm::ivec3(x, y, z));
+
+					if (cell < 0 || cellEntries[cell] < 0)
+						continue;
+
+					glm::vec3 difference = entryTargets[cellEntries[cell]] - target;
+					float distance = glm::dot(difference, difference);
+
+					if (nearest < 0 || distance < nearestDistance)
+					{
+						nearest = cellEntries[cell];
+						nearestDistance = distance;
+					}
+				}
+
+		return nearest;
+	}
+};
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef IK_CONFIG_HEADER
+#define IK_CONFIG_HEADER
+
+//target workspace
+#define TARGET_HEIGHT_MAX_LIMIT 4.0f
+#define TARGET_HEIGHT_MIN_LIMIT 3.0f
+#define TARGET_WIDTH_LENGTH_LIMIT 3.0f //center of this constrain box is at 0.0
+
+//solvers settings
+#define CCD_ITERATIONS_NUM 1000
+#define FABRIK_ITERATIONS_NUM 20
+#define JACOBIAN_ITERATIONS_NUM 200
+#define EPSILON 0.001f
+#define TRACKING_BUDGET_US 2000.0f //solving time per frame (per published pose of the async solver) in tracking mode
+
+#endif
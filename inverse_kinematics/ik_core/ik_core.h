@@ -0,0 +1,180 @@
+#ifndef IK_CORE_HEADER
+#define IK_CORE_HEADER
+
+#include "ik_config.h"
+#include "bone.h"
+#include "skeleton.h"
+#include "ik_solver.h"
+#include "chain.h"
+#include "fabrik_solver.h"
+#include "jacobian_solver.h"
+#include "analytic_solver.h"
+#include "multi_effector_solver.h"
+#include "ik_tracker.h"
+#include "ik_cache.h"
+#include "ik_telemetry.h"
+#include "ik_batch.h"
+
+enum IKSolverType
+{
+	IK_SOLVER_CCD,
+	IK_SOLVER_FABRIK,
+	IK_SOLVER_JACOBIAN_TRANSPOSE,
+	IK_SOLVER_DLS,
+	IK_SOLVER_SDLS
+};
+
+//independent IK instance, owns the skeleton, its target, the solvers with their scratch buffers and the tracking state,
+//there is no shared state between contexts so every context can be solved on its own thread
+class IKContext
+{
+public:
+	Skeleton skeleton;
+	int endEffectorIndex;
+	glm::vec3 target;
+	bool warmStart; //Solve starts from the cached pose of the nearest previously reached target
+	bool analyticLimbs; //Solve uses closed form IK for chains of two and three bones, DLS finishes the limbs it does not fit
+	bool traceResiduals; //Solve records squared distance after every iteration in the result
+	IKSolveResult result; //outcome of the last Solve call or of the current target in tracking mode
+	IKTelemetry telemetry; //all solves and tracked targets since it was cleared
+	std::vector<IKEffector> effectors; //solved together by SolveEffectors, endEffectorIndex and target are not used there
+	IKTracker tracker; //progress of Track calls
+	IKWarmStartCache cache;
+
+	IKContext()
+		: cache(glm::vec3(-TARGET_WIDTH_LENGTH_LIMIT / 2, 0.0f, -TARGET_WIDTH_LENGTH_LIMIT / 2),
+			glm::vec3(TARGET_WIDTH_LENGTH_LIMIT / 2, TARGET_HEIGHT_MAX_LIMIT, TARGET_WIDTH_LENGTH_LIMIT / 2)),
+		analyticSolver(&dlsSolver)
+	{
+		endEffectorIndex = -1;
+		target = glm::vec3(0.0f);
+		warmStart = false;
+		analyticLimbs = true;
+		traceResiduals = false;
+	}
+
+	//copies the bone tree into the context, end effector must be one of its bones
+	void SetSkeleton(Bone* root, Bone* endEffector)
+	{
+		std::vector<Bone*> bones;
+		skeleton = Skeleton(root, &bones);
+		endEffectorIndex = (int)(std::find(bones.begin(), bones.end(), endEffector) - bones.begin());
+		cache.Clear();
+	}
+
+	IKSolver& GetSolver(IKSolverType type)
+	{
+		switch (type)
+		{
+		case IK_SOLVER_FABRIK:
+			return fabrikSolver;
+		case IK_SOLVER_JACOBIAN_TRANSPOSE:
+			return jacobianTransposeSolver;
+		case IK_SOLVER_DLS:
+			return dlsSolver;
+		case IK_SOLVER_SDLS:
+			return sdlsSolver;
+		default:
+			return ccdSolver;
+		}
+	}
+
+	//moves end effector towards the target starting from the current pose, result.converged is true if it was reached within epsilon
+	const IKSolveResult& Solve(IKSolverType type, int maxIterations, float epsilon = EPSILON)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		if (warmStart)
+			cache.Seed(skeleton, endEffectorIndex, target);
+
+		IKSolver* solver = &GetSolver(type);
+
+		//Euler joints rarely fit the closed form pose in one step, CCD would stall near it at its 0.99 dot threshold,
+		//so limbs are finished by DLS whichever solver was chosen
+		if (analyticLimbs && AnalyticSolver::IsLimb(skeleton, endEffectorIndex))
+			solver = &analyticSolver;
+
+		result.residuals.clear();
+		solver->residuals = traceResiduals ? &result.residuals : NULL;
+		result.converged = solver->Solve(skeleton, endEffectorIndex, target, maxIterations, epsilon);
+		result.iterationsNum = solver->iterationsNum;
+
+		if (warmStart && result.converged)
+			cache.Store(skeleton, target);
+
+		result.time = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+		result.squaredDistance = CalcSquaredDistance();
+		telemetry.Add(result, target, epsilon);
+
+		return result;
+	}
+
+	//moves all effectors towards their targets at once, bones shared by several effectors move for all of them,
+	//result.squaredDistance is the largest one and telemetry gets the target of that effector
+	const IKSolveResult& SolveEffectors(int maxIterations, float epsilon = EPSILON)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		result.residuals.clear();
+		multiEffectorSolver.residuals = traceResiduals ? &result.residuals : NULL;
+		result.converged = multiEffectorSolver.Solve(skeleton, effectors, maxIterations, epsilon);
+		result.iterationsNum = multiEffectorSolver.iterationsNum;
+		result.time = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+
+		int worst = 0;
+		result.squaredDistance = 0.0f;
+
+		for (size_t e = 0; e < effectors.size(); e++)
+		{
+			glm::vec3 differnce = glm::vec3(skeleton.GetBoneEnd(effectors[e].boneIndex)) - effectors[e].target;
+
+			if (dot(differnce, differnce) > result.squaredDistance)
+			{
+				result.squaredDistance = dot(differnce, differnce);
+				worst = (int)e;
+			}
+		}
+
+		telemetry.Add(result, effectors.empty() ? target : effectors[worst].target, epsilon);
+
+		return result;
+	}
+
+	//tracking mode, called every frame, runs the solver for at most budget microseconds and continues on the next call,
+	//maxIterations limits iterations spent on one target over all frames, result covers all frames spent on the target
+	//(without the residual trace) and it is added to telemetry once solving of the target stops
+	bool Track(IKSolverType type, int maxIterations, float budget, float epsilon = EPSILON)
+	{
+		IKSolver& solver = GetSolver(type);
+		solver.residuals = NULL;
+		tracker.Update(solver, skeleton, endEffectorIndex, target, maxIterations, budget, epsilon);
+
+		result.residuals.clear();
+		result.converged = tracker.converged;
+		result.iterationsNum = tracker.iterationsNum;
+		result.time = tracker.time;
+		result.squaredDistance = CalcSquaredDistance();
+
+		if (tracker.finished)
+			telemetry.Add(result, target, epsilon);
+
+		return tracker.converged;
+	}
+
+private:
+	ChainCCDSolver ccdSolver; //same poses as CCDSolver, faster on chains of up to CHAIN_MAX_JOINTS bones
+	FABRIKSolver fabrikSolver;
+	JacobianTransposeSolver jacobianTransposeSolver;
+	DLSSolver dlsSolver;
+	SDLSSolver sdlsSolver;
+	AnalyticSolver analyticSolver;
+	MultiEffectorSolver multiEffectorSolver;
+
+	float CalcSquaredDistance() const
+	{
+		glm::vec3 differnce = glm::vec3(skeleton.GetBoneEnd(endEffectorIndex)) - target;
+		return dot(differnce, differnce);
+	}
+};
+
+#endif
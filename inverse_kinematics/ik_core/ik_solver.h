@@ -0,0 +1,47 @@
+#ifndef IK_SOLVER_HEADER
+#define IK_SOLVER_HEADER
+
+#include "skeleton.h"
+
+//algorithm that rotates bones of the chain ending with endEffectorIndex so that its end reaches the target,
+//implementations must keep angles within bone constraints
+class IKSolver
+{
+public:
+	int iterationsNum; //iterations used by the last Solve call
+	std::vector<float>* residuals; //if not NULL, squared distance to the target is appended after every iteration
+
+	IKSolver()
+	{
+		iterationsNum = 0;
+		residuals = NULL;
+	}
+
+	virtual ~IKSolver()
+	{
+	}
+
+	//returns true if target was reached within epsilon (squared distance)
+	virtual bool Solve(Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target, int maxIterations, float epsilon) = 0;
+
+protected:
+	void TraceResidual(const Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target)
+	{
+		if (residuals == NULL)
+			return;
+
+		glm::vec3 differnce = glm::vec3(skeleton.GetBoneEnd(endEffectorIndex)) - target;
+		residuals->push_back(dot(differnce, differnce));
+	}
+};
+
+class CCDSolver : public IKSolver
+{
+public:
+	bool Solve(Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target, int maxIterations, float epsilon)
+	{
+		return skeleton.SolveCCD(endEffectorIndex, target, maxIterations, epsilon, &iterationsNum, residuals);
+	}
+};
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef IK_TELEMETRY_HEADER
+#define IK_TELEMETRY_HEADER
+
+#include <cstdio>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "glm/glm.hpp"
+
+#define TELEMETRY_BUCKETS_NUM 24
+#define TELEMETRY_WORST_SOLVES_NUM 16 //solves with the most iterations kept with their targets
+
+//outcome of one solve
+struct IKSolveResult
+{
+	bool converged;
+	int iterationsNum;
+	float squaredDistance; //between the end effector and the target after solving
+	float time; //wall time in microseconds
+	std::vector<float> residuals; //squared distance after every iteration, filled only when tracing is enabled
+
+	IKSolveResult()
+	{
+		converged = false;
+		iterationsNum = 0;
+		squaredDistance = 0.0f;
+		time = 0.0f;
+	}
+};
+
+//counts of values in power of two buckets, bucket 0 holds values below 1, bucket i holds values in [2^(i-1), 2^i),
+//the last bucket holds everything above
+class IKHistogram
+{
+public:
+	int counts[TELEMETRY_BUCKETS_NUM];
+
+	IKHistogram()
+	{
+		Clear();
+	}
+
+	void Clear()
+	{
+		std::fill(counts, counts + TELEMETRY_BUCKETS_NUM, 0);
+	}
+
+	void Add(float value)
+	{
+		int bucket = 0;
+
+		if (value >= 1.0f)
+		{
+			frexp(value, &bucket);
+			bucket = std::min(bucket, TELEMETRY_BUCKETS_NUM - 1);
+		}
+
+		counts[bucket]++;
+	}
+
+	static float BucketMin(int bucket)
+	{
+		return bucket == 0 ? 0.0f : ldexp(1.0f, bucket - 1);
+	}
+
+	static float BucketMax(int bucket)
+	{
+		return ldexp(1.0f, bucket);
+	}
+};
+
+//aggregated statistics of solves, used to find targets the solvers struggle with and to tune iteration limits
+class IKTelemetry
+{
+public:
+	struct Solve
+	{
+		glm::vec3 target;
+		bool converged;
+		int iterationsNum;
+		float squaredDistance;
+		float time;
+	};
+
+	int solvesNum;
+	int convergedNum;
+	long long iterationsNum;
+	double time; //microseconds
+	int maxIterationsNum;
+	float maxTime;
+	IKHistogram iterationsHistogram;
+	IKHistogram timeHistogram; //microseconds
+	IKHistogram residualHistogram; //final squared distance in multiples of epsilon, bucket 0 holds converged solves
+	std::vector<Solve> worstSolves; //most iterations first, ties ordered by the final distance
+
+	IKTelemetry()
+	{
+		Clear();
+	}
+
+	void Clear()
+	{
+		solvesNum = 0;
+		convergedNum = 0;
+		iterationsNum = 0;
+		time = 0.0;
+		maxIterationsNum = 0;
+		maxTime = 0.0f;
+		iterationsHistogram.Clear();
+		timeHistogram.Clear();
+		residualHistogram.Clear();
+		worstSolves.clear();
+	}
+
+	void Add(const IKSolveResult& result, const glm::vec3& target, float epsilon)
+	{
+		solvesNum++;
+		convergedNum += result.converged ? 1 : 0;
+		iterationsNum += result.iterationsNum;
+		time += result.time;
+		maxIterationsNum = std::max(maxIterationsNum, result.iterationsNum);
+		maxTime = std::max(maxTime, result.time);
+
+		iterationsHistogram.Add((float)result.iterationsNum);
+		timeHistogram.Add(result.time);
+		residualHistogram.Add(result.squaredDistance / epsilon);
+
+		Solve solve;
+		solve.target = target;
+		solve.converged = result.converged;
+		solve.iterationsNum = result.iterationsNum;
+		solve.squaredDistance = result.squaredDistance;
+		solve.time = result.time;
+
+		if (worstSolves.size() == TELEMETRY_WORST_SOLVES_NUM && !IsWorse(solve, worstSolves.back()))
+			return;
+
+		worstSolves.insert(std::upper_bound(worstSolves.begin(), worstSolves.end(), solve, IsWorse), solve);
+
+		if (worstSolves.size() > TELEMETRY_WORST_SOLVES_NUM)
+			worstSolves.pop_back();
+	}
+
+	//counters as name,,,value rows followed by histogram,bucket_min,bucket_max,count rows
+	void WriteCSV(FILE* file) const
+	{
+		fprintf(file, "name,min,max,count\n");
+		fprintf(file, "solves,,,%d\n", solvesNum);
+		fprintf(file, "converged,,,%d\n", convergedNum);
+		fprintf(file, "iterations,,,%lld\n", iterationsNum);
+		fprintf(file, "time_us,,,%.1f\n", time);
+		fprintf(file, "max_iterations,,,%d\n", maxIterationsNum);
+		fprintf(file, "max_time_us,,,%.1f\n", maxTime);
+		WriteHistogramCSV(file, "iterations_histogram", iterationsHistogram);
+		WriteHistogramCSV(file, "time_us_histogram", timeHistogram);
+		WriteHistogramCSV(file, "residual_epsilons_histogram", residualHistogram);
+	}
+
+	void WriteJSON(FILE* file) const
+	{
+		fprintf(file, "{\n");
+		fprintf(file, "  \"solves\": %d,\n", solvesNum);
+		fprintf(file, "  \"converged\": %d,\n", convergedNum);
+		fprintf(file, "  \"iterations\": { \"total\": %lld, \"mean\": %.2f, \"max\": %d },\n", iterationsNum, solvesNum > 0 ? (double)iterationsNum / solvesNum : 0.0, maxIterationsNum);
+		fprintf(file, "  \"time_us\": { \"total\": %.1f, \"mean\": %.2f, \"max\": %.2f },\n", time, solvesNum > 0 ? time / solvesNum : 0.0, maxTime);
+		WriteHistogramJSON(file, "iterations_histogram", iterationsHistogram);
+		WriteHistogramJSON(file, "time_us_histogram", timeHistogram);
+		WriteHistogramJSON(file, "residual_epsilons_histogram", residualHistogram);
+		fprintf(file, "  \"worst_solves\": [");
+
+		for (size_t i = 0; i < worstSolves.size(); i++)
+		{
+			const Solve& solve = worstSolves[i];
+			fprintf(file, "%s\n    { \"target\": [%g, %g, %g], \"converged\": %s, \"iterations\": %d, \"squared_distance\": %g, \"time_us\": %.2f }",
+				i == 0 ? "" : ",", solve.target.x, solve.target.y, solve.target.z, solve.converged ? "true" : "false", solve.iterationsNum, solve.squaredDistance, solve.time);
+		}
+
+		fprintf(file, "\n  ]\n}\n");
+	}
+
+private:
+	static bool IsWorse(const Solve& a, const Solve& b)
+	{
+		if (a.iterationsNum != b.iterationsNum)
+			return a.iterationsNum > b.iterationsNum;
+
+		return a.squaredDistance > b.squaredDistance;
+	}
+
+	static void WriteHistogramCSV(FILE* file, const char* name, const IKHistogram& histogram)
+	{
+		for (int i = 0; i < TELEMETRY_BUCKETS_NUM; i++)
+			if (histogram.counts[i] > 0)
+				fprintf(file, "%s,%g,%g,%d\n", name, IKHistogram::BucketMin(i), IKHistogram::BucketMax(i), histogram.counts[i]);
+	}
+
+	//empty buckets are skipped
+	static void WriteHistogramJSON(FILE* file, const char* name, const IKHistogram& histogram)
+	{
+		fprintf(file, "  \"%s\": [", name);
+		bool first = true;
+
+		for (int i = 0; i < TELEMETRY_BUCKETS_NUM; i++)
+		{
+			if (histogram.counts[i] == 0)
+				continue;
+
+			fprintf(file, "%s{ \"min\": %g, \"max\": %g, \"count\": %d }", first ? " " : ", ", IKHistogram::BucketMin(i), IKHistogram::BucketMax(i), histogram.counts[i]);
+			first = false;
+		}
+
+		fprintf(file, " ],\n");
+	}
+};
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef IK_TRACKER_HEADER
+#define IK_TRACKER_HEADER
+
+#include <chrono>
+#include "ik_solver.h"
+
+//follows a moving target by running the solver for a limited time every frame, so frame time stays bounded,
+//pose and the number of iterations spent on the target are kept between frames and solving resumes where it stopped,
+//solvers keep no state between iterations except the pose, so sliced solving ends in the same pose as one long Solve call
+//(FABRIK stops at once on a target out of reach, here it keeps straightening the chain until maxIterations)
+class IKTracker
+{
+public:
+	int iterationsNum; //iterations spent on the current target over all frames
+	float time; //microseconds spent on the current target over all frames
+	bool converged;
+	bool finished; //set by the Update call that stopped solving of the current target
+
+	IKTracker()
+	{
+		Reset();
+	}
+
+	//next Update starts over even if the target is the same
+	void Reset()
+	{
+		iterationsNum = 0;
+		time = 0.0f;
+		converged = false;
+		finished = false;
+		lastSolver = NULL;
+		lastTarget = glm::vec3(0.0f);
+	}
+
+	//runs iterations until the target is reached, maxIterations are spent on it or budget (microseconds) is over,
+	//at least one iteration is done every frame while the target is being solved, returns true once it was reached
+	bool Update(IKSolver& solver, Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target, int maxIterations, float budget, float epsilon)
+	{
+		if (&solver != lastSolver || target != lastTarget)
+		{
+			iterationsNum = 0;
+			time = 0.0f;
+			converged = false;
+			lastSolver = &solver;
+			lastTarget = target;
+		}
+
+		finished = false;
+
+		if (converged || iterationsNum >= maxIterations)
+			return converged;
+
+		auto start = std::chrono::high_resolution_clock::now();
+		float elapsed;
+
+		do
+		{
+			converged = solver.Solve(skeleton, endEffectorIndex, target, 1, epsilon);
+			iterationsNum += solver.iterationsNum;
+			elapsed = std::chrono::duration<float, std::micro>(std::chrono::high_resolution_clock::now() - start).count();
+		}
+		while (!converged && iterationsNum < maxIterations && elapsed < budget);
+
+		time += elapsed;
+		finished = converged || iterationsNum >= maxIterations;
+
+		return converged;
+	}
+
+private:
+	IKSolver* lastSolver;
+	glm::vec3 lastTarget;
+};
+
+#endif
@@ -0,0 +1,228 @@
+#ifndef JACOBIAN_SOLVER_HEADER
+#define JACOBIAN_SOLVER_HEADER
+
+#include "ik_solver.h"
+
+#define PI_F 3.14159265f
+
+#define JACOBIAN_MAX_ERROR 0.2f //longer steps towards the target are clamped, linearization is not valid far away
+#define DLS_DAMPING 0.1f
+#define SDLS_MAX_ANGLE_CHANGE (PI_F / 4.0f)
+#define JACOBI_SWEEPS_NUM 8
+
+//base of solvers that move the end effector along the error using the Jacobian of its position,
+//Jacobian columns are built analytically from the joint axes and pivots of world transforms,
+//its 3x3 products are all the linear algebra needed so there are no allocations inside the iterations
+class JacobianSolver : public IKSolver
+{
+public:
+	bool Solve(Skeleton& skeleton, int endEffectorIndex, const glm::vec3& target, int maxIterations, float epsilon)
+	{
+		skeleton.GetChain(endEffectorIndex, chain);
+
+		//root bone is never rotated
+		int jointsNum = (int)chain.size() - 1;
+		jacobian.resize(jointsNum * 3);
+		angleChanges.resize(jointsNum * 3);
+
+		for (size_t c = 0; c < chain.size(); c++)
+			skeleton.CalcTransform(chain[c]);
+
+		for (iterationsNum = 0; iterationsNum < maxIterations; iterationsNum++)
+		{
+			glm::vec3 endPosition = glm::vec3(skeleton.GetBoneEnd(endEffectorIndex));
+			glm::vec3 error = target - endPosition;
+
+			if (dot(error, error) < epsilon)
+				return true;
+
+			float errorLength = glm::length(error);
+
+			if (errorLength > JACOBIAN_MAX_ERROR)
+				error *= JACOBIAN_MAX_ERROR / errorLength;
+
+			for (int j = 0; j < jointsNum; j++)
+			{
+				int bone = chain[j + 1];
+				glm::vec3 pivot = glm::vec3(skeleton.worldTransforms[bone][3]);
+				glm::vec3 axes[3];
+				skeleton.CalcJointAxes(bone, axes);
+
+				for (int k = 0; k < 3; k++)
+					jacobian[j * 3 + k] = glm::cross(axes[k], endPosition - pivot);
+			}
+
+			CalcAngleChanges(error);
+
+			skeleton.CheckConstrainsAndMax(chain.data() + 1, angleChanges.data(), jointsNum);
+
+			for (size_t c = 1; c < chain.size(); c++)
+				skeleton.CalcTransform(chain[c]);
+
+			TraceResidual(skeleton, endEffectorIndex, target);
+		}
+
+		glm::vec3 differnce = glm::vec3(skeleton.GetBoneEnd(endEffectorIndex)) - target;
+
+		return dot(differnce, differnce) < epsilon;
+	}
+
+protected:
+	std::vector<int> chain;
+	std::vector<glm::vec3> jacobian; //columns, three per joint
+	std::vector<float> angleChanges;
+
+	//fills angleChanges with the step that moves end effector by error
+	virtual void CalcAngleChanges(const glm::vec3& error) = 0;
+
+	//J * J^T
+	glm::mat3 CalcJacobianSquare() const
+	{
+		glm::mat3 square(0.0f);
+
+		for (size_t i = 0; i < jacobian.size(); i++)
+			square += glm::outerProduct(jacobian[i], jacobian[i]);
+
+		return square;
+	}
+
+	//angleChanges = J^T * v
+	void MultiplyTransposed(const glm::vec3& v)
+	{
+		for (size_t i = 0; i < jacobian.size(); i++)
+			angleChanges[i] = glm::dot(jacobian[i], v);
+	}
+};
+
+class JacobianTransposeSolver : public JacobianSolver
+{
+protected:
+	void CalcAngleChanges(const glm::vec3& error)
+	{
+		//step length that minimizes the error along J * J^T * error
+		glm::vec3 move = CalcJacobianSquare() * error;
+		float moveLength = glm::dot(move, move);
+		float alpha = moveLength > 0.0f ? glm::dot(error, move) / moveLength : 0.0f;
+
+		MultiplyTransposed(error * alpha);
+	}
+};
+
+//damped least squares, J^T * (J * J^T + damping^2 * I)^-1 * error
+class DLSSolver : public JacobianSolver
+{
+public:
+	DLSSolver(float damping = DLS_DAMPING)
+	{
+		this->damping = damping;
+	}
+
+protected:
+	float damping;
+
+	void CalcAngleChanges(const glm::vec3& error)
+	{
+		glm::mat3 damped = CalcJacobianSquare() + glm::mat3(damping * damping);
+		MultiplyTransposed(glm::inverse(damped) * error);
+	}
+};
+
+//selectively damped least squares (Buss and Kim), every singular direction gets its own clamp
+//depending on how much joints have to rotate to move along it, which keeps steps stable near singularities
+class SDLSSolver : public JacobianSolver
+{
+protected:
+	std::vector<float> singularChanges;
+
+	void CalcAngleChanges(const glm::vec3& error)
+	{
+		singularChanges.resize(jacobian.size());
+
+		for (size_t j = 0; j < angleChanges.size(); j++)
+			angleChanges[j] = 0.0f;
+
+		//J = U * S * V^T is found through eigen decomposition of J * J^T = U * S^2 * U^T
+		glm::vec3 squaredValues;
+		glm::mat3 u;
+		SymmetricEigen(CalcJacobianSquare(), squaredValues, u);
+
+		for (int i = 0; i < 3; i++)
+		{
+			if (squaredValues[i] < 1e-10f)
+				continue;
+
+			float singularValue = sqrt(squaredValues[i]);
+			float alpha = glm::dot(u[i], error);
+
+			//v_i = J^T * u_i / singularValue, M is how much joints rotate for unit move along u_i
+			float m = 0.0f;
+
+			for (size_t j = 0; j < jacobian.size(); j++)
+			{
+				float v = glm::dot(jacobian[j], u[i]) / singularValue;
+				singularChanges[j] = v * alpha / singularValue;
+				m += fabs(v) * glm::length(jacobian[j]);
+			}
+
+			m /= singularValue;
+
+			float maxChange = SDLS_MAX_ANGLE_CHANGE * std::min(1.0f, 1.0f / m);
+			ClampMaxAbs(singularChanges, maxChange);
+
+			for (size_t j = 0; j < angleChanges.size(); j++)
+				angleChanges[j] += singularChanges[j];
+		}
+
+		ClampMaxAbs(angleChanges, SDLS_MAX_ANGLE_CHANGE);
+	}
+
+	static void ClampMaxAbs(std::vector<float>& values, float maxAbs)
+	{
+		float currentMax = 0.0f;
+
+		for (size_t j = 0; j < values.size(); j++)
+			currentMax = std::max(currentMax, (float)fabs(values[j]));
+
+		if (currentMax <= maxAbs)
+			return;
+
+		for (size_t j = 0; j < values.size(); j++)
+			values[j] *= maxAbs / currentMax;
+	}
+
+	//Jacobi rotations, eigen vectors are the columns of vectors
+	static void SymmetricEigen(glm::mat3 a, glm::vec3& values, glm::mat3& vectors)
+	{
+		vectors = glm::mat3(1.0f);
+
+		for (int sweep = 0; sweep < JACOBI_SWEEPS_NUM; sweep++)
+		{
+			for (int p = 0; p < 2; p++)
+			{
+				for (int q = p + 1; q < 3; q++)
+				{
+					if (fabs(a[q][p]) < 1e-12f)
+						continue;
+
+					float theta = (a[q][q] - a[p][p]) / (2.0f * a[q][p]);
+					float t = (theta >= 0.0f ? 1.0f : -1.0f) / (fabs(theta) + sqrt(theta * theta + 1.0f));
+					float c = 1.0f / sqrt(t * t + 1.0f);
+					float s = t * c;
+
+					glm::mat3 rotation(1.0f);
+					rotation[p][p] = c;
+					rotation[q][q] = c;
+					rotation[q][p] = s;
+					rotation[p][q] = -s;
+
+					a = glm::transpose(rotation) * a * rotation;
+					vectors = vectors * rotation;
+				}
+			}
+		}
+
+		values = glm::vec3(a[0][0], a[1][1], a[2][2]);
+	}
+};
+
+#endif
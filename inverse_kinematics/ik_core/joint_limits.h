@@ -0,0 +1,44 @@
+#ifndef JOINT_LIMITS_HEADER
+#define JOINT_LIMITS_HEADER
+
+#include "glm/glm.hpp"
+#include "float_pack.h"
+
+#define DEGREE_EPSILON 0.1f
+
+//changes angle change d so that the new angle stays within [-180, 180] and within the limits, an angle that would leave them
+//stops DEGREE_EPSILON inside, all lanes are independent (axes of one joint or skeletons of a pack) and there are no branches
+template<typename Pack>
+inline Pack ClampAngleChange(Pack d, const Pack& angle, const Pack& limitMin, const Pack& limitMax)
+{
+	d = Select(Greater(d + angle, Pack(180.0f)), d - Pack(360.0f), d);
+	d = Select(Less(d + angle, Pack(-180.0f)), d + Pack(360.0f), d);
+	d = Select(Greater(d + angle, limitMax), limitMax - angle - Pack(DEGREE_EPSILON), d);
+	d = Select(Less(d + angle, limitMin), limitMin - angle + Pack(DEGREE_EPSILON), d);
+
+	return d;
+}
+
+//all three axes of one joint at once, every axis against its own limits
+inline void ClampAngleChanges(glm::vec3& delta, const glm::vec3& rotation, const glm::vec3& limitMin, const glm::vec3& limitMax)
+{
+	FloatPack<4> d = MakePack(delta.x, delta.y, delta.z, 0.0f);
+	FloatPack<4> r = MakePack(rotation.x, rotation.y, rotation.z, 0.0f);
+	FloatPack<4> l = MakePack(limitMin.x, limitMin.y, limitMin.z, 0.0f);
+	FloatPack<4> u = MakePack(limitMax.x, limitMax.y, limitMax.z, 0.0f);
+
+	float clamped[4];
+	ClampAngleChange(d, r, l, u).Store(clamped);
+
+	delta = glm::vec3(clamped[0], clamped[1], clamped[2]);
+}
+
+//same for other precisions, axis by axis
+template<typename Scalar>
+inline void ClampAngleChanges(glm::tvec3<Scalar>& delta, const glm::tvec3<Scalar>& rotation, const glm::tvec3<Scalar>& limitMin, const glm::tvec3<Scalar>& limitMax)
+{
+	for (int i = 0; i < 3; i++)
+		delta[i] = ClampAngleChange(delta[i], rotation[i], limitMin[i], limitMax[i]);
+}
+
+#endif
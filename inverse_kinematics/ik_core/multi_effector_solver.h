@@ -0,0 +1,319 @@
+#ifndef MULTI_EFFECTOR_SOLVER_HEADER
+#define MULTI_EFFECTOR_SOLVER_HEADER
+
+#include "jacobian_solver.h"
+
+//bone whose end is pulled towards the target, effectors of higher priority are satisfied first and lower ones
+//only use what is left of the motion, effectors of the same priority are blended by weight
+struct IKEffector
+{
+	int boneIndex;
+	glm::vec3 target;
+	float weight;
+	int priority;
+
+	IKEffector(int boneIndex = -1, const glm::vec3& target = glm::vec3(0.0f), float weight = 1.0f, int priority = 0)
+	{
+		this->boneIndex = boneIndex;
+		this->target = target;
+		this->weight = weight;
+		this->priority = priority;
+	}
+};
+
+//damped least squares over a tree of bones with several end effectors, Jacobians of all effectors are stacked so bones they share
+//(a spine below two arms) move once for all of them instead of being pulled back and forth by separate chain solves,
+//priority levels are solved one after another in the null space of the levels above them (Siciliano and Slotine)
+class MultiEffectorSolver
+{
+public:
+	int iterationsNum; //iterations used by the last Solve call
+	std::vector<float>* residuals; //if not NULL, largest squared distance of an effector is appended after every iteration
+
+	MultiEffectorSolver(float damping = DLS_DAMPING)
+	{
+		this->damping = damping;
+		iterationsNum = 0;
+		residuals = NULL;
+	}
+
+	//returns true if all effectors reached their targets within epsilon (squared distance)
+	bool Solve(Skeleton& skeleton, const std::vector<IKEffector>& effectors, int maxIterations, float epsilon)
+	{
+		Prepare(skeleton, effectors);
+
+		for (size_t j = 0; j < joints.size(); j++)
+			skeleton.CalcTransform(joints[j]);
+
+		for (iterationsNum = 0; iterationsNum < maxIterations; iterationsNum++)
+		{
+			if (CalcMaxSquaredDistance(skeleton, effectors) < epsilon)
+				return true;
+
+			for (size_t j = 0; j < joints.size(); j++)
+			{
+				pivots[j] = glm::vec3(skeleton.worldTransforms[joints[j]][3]);
+				skeleton.CalcJointAxes(joints[j], &axes[j * 3]);
+			}
+
+			std::fill(angleChanges.begin(), angleChanges.end(), 0.0f);
+
+			for (size_t l = 0; l < levels.size(); l++)
+				SolveLevel(skeleton, effectors, (int)l);
+
+			skeleton.CheckConstrainsAndMax(joints.data(), angleChanges.data(), (int)joints.size());
+
+			for (size_t j = 0; j < joints.size(); j++)
+				skeleton.CalcTransform(joints[j]);
+
+			if (residuals != NULL)
+				residuals->push_back(CalcMaxSquaredDistance(skeleton, effectors));
+		}
+
+		return CalcMaxSquaredDistance(skeleton, effectors) < epsilon;
+	}
+
+	static float CalcMaxSquaredDistance(const Skeleton& skeleton, const std::vector<IKEffector>& effectors)
+	{
+		float maxDistance = 0.0f;
+
+		for (size_t e = 0; e < effectors.size(); e++)
+		{
+			glm::vec3 differnce = glm::vec3(skeleton.GetBoneEnd(effectors[e].boneIndex)) - effectors[e].target;
+			maxDistance = std::max(maxDistance, dot(differnce, differnce));
+		}
+
+		return maxDistance;
+	}
+
+private:
+	float damping;
+
+	std::vector<int> joints; //bones moved by the effectors in topological order, root bone is never rotated
+	std::vector<int> jointColumns; //joint of every bone of the skeleton, -1 if the bone is not moved
+	std::vector<char> influences; //joint j moves effector e if influences[e * joints.size() + j] is set
+	std::vector<std::vector<int> > levels; //effectors grouped by priority, highest first
+	std::vector<glm::vec3> pivots;
+	std::vector<glm::vec3> axes; //three per joint
+
+	//dense scratch matrices, row major, columns are joint axes
+	std::vector<float> angleChanges;
+	std::vector<float> projection; //null space of the levels solved so far
+	std::vector<float> jacobian; //rows of the current level
+	std::vector<float> projected; //jacobian * projection
+	std::vector<float> square; //projected * projected^T + damping^2 * I
+	std::vector<float> solved; //square^-1 * projected, its transpose is the damped pseudo inverse
+	std::vector<float> errors; //replaced by square^-1 * errors
+
+	void Prepare(const Skeleton& skeleton, const std::vector<IKEffector>& effectors)
+	{
+		jointColumns.assign(skeleton.Size(), -1);
+
+		for (size_t e = 0; e < effectors.size(); e++)
+			for (int i = effectors[e].boneIndex; skeleton.parentIndices[i] >= 0; i = skeleton.parentIndices[i])
+				jointColumns[i] = 0;
+
+		joints.clear();
+
+		for (int i = 0; i < skeleton.Size(); i++)
+			if (jointColumns[i] >= 0)
+			{
+				jointColumns[i] = (int)joints.size();
+				joints.push_back(i);
+			}
+
+		influences.assign(effectors.size() * joints.size(), 0);
+
+		for (size_t e = 0; e < effectors.size(); e++)
+			for (int i = effectors[e].boneIndex; skeleton.parentIndices[i] >= 0; i = skeleton.parentIndices[i])
+				influences[e * joints.size() + jointColumns[i]] = 1;
+
+		//sorted by priority, order of effectors with the same priority is kept
+		std::vector<int> order(effectors.size());
+
+		for (size_t e = 0; e < effectors.size(); e++)
+			order[e] = (int)e;
+
+		std::stable_sort(order.begin(), order.end(), [&effectors](int a, int b) { return effectors[a].priority > effectors[b].priority; });
+
+		levels.clear();
+
+		for (size_t o = 0; o < order.size(); o++)
+		{
+			if (o == 0 || effectors[order[o]].priority != effectors[order[o - 1]].priority)
+				levels.push_back(std::vector<int>());
+
+			levels.back().push_back(order[o]);
+		}
+
+		int columnsNum = (int)joints.size() * 3;
+		pivots.resize(joints.size());
+		axes.resize(columnsNum);
+		angleChanges.resize(columnsNum);
+	}
+
+	//moves effectors of the level towards their targets as far as possible without disturbing levels above it
+	void SolveLevel(const Skeleton& skeleton, const std::vector<IKEffector>& effectors, int level)
+	{
+		const std::vector<int>& levelEffectors = levels[level];
+		int rowsNum = (int)levelEffectors.size() * 3;
+		int columnsNum = (int)angleChanges.size();
+		bool first = level == 0;
+		bool last = level == (int)levels.size() - 1;
+
+		jacobian.assign(rowsNum * columnsNum, 0.0f);
+		errors.resize(rowsNum);
+
+		for (size_t le = 0; le < levelEffectors.size(); le++)
+		{
+			const IKEffector& effector = effectors[levelEffectors[le]];
+			glm::vec3 endPosition = glm::vec3(skeleton.GetBoneEnd(effector.boneIndex));
+			glm::vec3 error = effector.target - endPosition;
+			float errorLength = glm::length(error);
+
+			if (errorLength > JACOBIAN_MAX_ERROR)
+				error *= JACOBIAN_MAX_ERROR / errorLength;
+
+			for (size_t j = 0; j < joints.size(); j++)
+			{
+				if (!influences[levelEffectors[le] * joints.size() + j])
+					continue;
+
+				for (int k = 0; k < 3; k++)
+				{
+					glm::vec3 column = glm::cross(axes[j * 3 + k], endPosition - pivots[j]) * effector.weight;
+
+					for (int r = 0; r < 3; r++)
+						jacobian[(le * 3 + r) * columnsNum + j * 3 + k] = column[r];
+				}
+			}
+
+			for (int r = 0; r < 3; r++)
+				errors[le * 3 + r] = error[r] * effector.weight;
+		}
+
+		//part of the error left after the levels above moved the joints
+		if (!first)
+			for (int r = 0; r < rowsNum; r++)
+				for (int c = 0; c < columnsNum; c++)
+					errors[r] -= jacobian[r * columnsNum + c] * angleChanges[c];
+
+		//first level moves in the whole joint space
+		if (first && !last)
+		{
+			projection.assign(columnsNum * columnsNum, 0.0f);
+
+			for (int c = 0; c < columnsNum; c++)
+				projection[c * columnsNum + c] = 1.0f;
+		}
+
+		if (first)
+			projected = jacobian;
+		else
+			Multiply(jacobian, projection, rowsNum, columnsNum, columnsNum, projected);
+
+		square.assign(rowsNum * rowsNum, 0.0f);
+
+		for (int a = 0; a < rowsNum; a++)
+			for (int b = 0; b <= a; b++)
+			{
+				float sum = a == b ? damping * damping : 0.0f;
+
+				for (int c = 0; c < columnsNum; c++)
+					sum += projected[a * columnsNum + c] * projected[b * columnsNum + c];
+
+				square[a * rowsNum + b] = square[b * rowsNum + a] = sum;
+			}
+
+		CholeskyFactor(square, rowsNum);
+
+		//angle changes = projected^T * square^-1 * errors
+		CholeskySolve(square, rowsNum, errors, 1);
+
+		for (int r = 0; r < rowsNum; r++)
+			for (int c = 0; c < columnsNum; c++)
+				angleChanges[c] += projected[r * columnsNum + c] * errors[r];
+
+		if (last)
+			return;
+
+		solved = projected;
+		CholeskySolve(square, rowsNum, solved, columnsNum);
+
+		//projection -= pinv * projected
+		for (int a = 0; a < columnsNum; a++)
+			for (int b = 0; b < columnsNum; b++)
+			{
+				float sum = 0.0f;
+
+				for (int r = 0; r < rowsNum; r++)
+					sum += solved[r * columnsNum + a] * projected[r * columnsNum + b];
+
+				projection[a * columnsNum + b] -= sum;
+			}
+	}
+
+	static void Multiply(const std::vector<float>& a, const std::vector<float>& b, int rowsNum, int innerNum, int columnsNum, std::vector<float>& result)
+	{
+		result.assign(rowsNum * columnsNum, 0.0f);
+
+		for (int r = 0; r < rowsNum; r++)
+			for (int i = 0; i < innerNum; i++)
+			{
+				float value = a[r * innerNum + i];
+
+				if (value == 0.0f)
+					continue;
+
+				for (int c = 0; c < columnsNum; c++)
+					result[r * columnsNum + c] += value * b[i * columnsNum + c];
+			}
+	}
+
+	//replaces symmetric positive definite matrix (it is damped) by its Cholesky factor L, matrix = L * L^T
+	static void CholeskyFactor(std::vector<float>& matrix, int size)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			for (int j = 0; j <= i; j++)
+			{
+				float sum = matrix[i * size + j];
+
+				for (int k = 0; k < j; k++)
+					sum -= matrix[i * size + k] * matrix[j * size + k];
+
+				matrix[i * size + j] = i == j ? sqrt(std::max(sum, 1e-12f)) : sum / matrix[j * size + j];
+			}
+		}
+	}
+
+	//solves L * L^T * x = values in place for every column of values, factor comes from CholeskyFactor
+	static void CholeskySolve(const std::vector<float>& factor, int size, std::vector<float>& values, int columnsNum)
+	{
+		for (int i = 0; i < size; i++)
+		{
+			float inverse = 1.0f / factor[i * size + i];
+
+			for (int k = 0; k < i; k++)
+				for (int c = 0; c < columnsNum; c++)
+					values[i * columnsNum + c] -= factor[i * size + k] * values[k * columnsNum + c];
+
+			for (int c = 0; c < columnsNum; c++)
+				values[i * columnsNum + c] *= inverse;
+		}
+
+		for (int i = size - 1; i >= 0; i--)
+		{
+			float inverse = 1.0f / factor[i * size + i];
+
+			for (int k = i + 1; k < size; k++)
+				for (int c = 0; c < columnsNum; c++)
+					values[i * columnsNum + c] -= factor[k * size + i] * values[k * columnsNum + c];
+
+			for (int c = 0; c < columnsNum; c++)
+				values[i * columnsNum + c] *= inverse;
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,546 @@
+#ifndef SKELETON_HEADER
+#define SKELETON_HEADER
+
+#include <assert.h>
+#include <vector>
+#include <algorithm>
+#include "glm/glm.hpp"
+#include "glm/gtx/vector_angle.hpp"
+#include "glm/gtc/quaternion.hpp"
+#include "glm/gtx/quaternion.hpp"
+#include "glm/gtc/constants.hpp"
+
+#include "bone.h"
+#include "bone_array.h"
+
+#define JOINT_FIT_STEPS 2
+#define JOINT_FIT_DAMPING 0.1f
+#define SKELETON_MIN_CAPACITY 8
+
+//flat representation of the bone tree, bones are stored in contiguous arrays in topological order
+//(every parent goes before its children), so FK and CCD are linear passes without pointer chasing,
+//all arrays live in one arena addressed by bone indices only, so a copy of the skeleton is one allocation and memcpy
+//(none at all when the destination is large enough) and the arrays are placed in the copied arena again
+class Skeleton
+{
+public:
+	BoneArray<int> parentIndices; //-1 for the root bone
+	BoneArray<glm::vec3> rotations;
+	BoneArray<float> boneLengths;
+	BoneArray<glm::vec3> constraintsMin;
+	BoneArray<glm::vec3> constraintsMax;
+	BoneArray<glm::mat4> worldTransforms;
+	glm::mat4 rootTransform; //world transform of the root bone, places the skeleton in the world
+
+	//quaternion joints, used instead of rotations and per axis constraints when quaternionJoints is set, constraintsMin
+	//and constraintsMax are ignored then and only these limits apply, they are in radians: swing is the largest angle
+	//between the bone and its parent, twist is rotation around the bone itself
+	bool quaternionJoints;
+	BoneArray<glm::quat> orientations;
+	BoneArray<float> swingLimits;
+	BoneArray<glm::vec2> twistLimits;
+
+	Skeleton()
+	{
+		rootTransform = InitialSceletonRotation();
+		quaternionJoints = false;
+		bonesNum = 0;
+		capacity = 0;
+	}
+
+	//bones receives tree nodes in the same order as they are stored in the skeleton
+	Skeleton(Bone* root, std::vector<Bone*>* bones = NULL)
+	{
+		rootTransform = InitialSceletonRotation();
+		quaternionJoints = false;
+		bonesNum = 0;
+		capacity = 0;
+
+		std::vector<Bone*> order;
+		AddBoneTree(root, -1, order);
+
+		if (bones != NULL)
+			bones->swap(order);
+
+		CalcTransforms();
+	}
+
+	Skeleton(const Skeleton& skeleton)
+		: arena(skeleton.arena)
+	{
+		CopySettings(skeleton);
+		Layout(arena.data());
+	}
+
+	Skeleton(Skeleton&& skeleton)
+	{
+		arena.swap(skeleton.arena);
+		CopySettings(skeleton);
+		Layout(arena.data());
+		skeleton.Reset();
+	}
+
+	//reuses the arena if it is large enough
+	Skeleton& operator=(const Skeleton& skeleton)
+	{
+		if (this != &skeleton)
+		{
+			arena = skeleton.arena;
+			CopySettings(skeleton);
+			Layout(arena.data());
+		}
+
+		return *this;
+	}
+
+	Skeleton& operator=(Skeleton&& skeleton)
+	{
+		if (this != &skeleton)
+		{
+			arena.swap(skeleton.arena);
+			CopySettings(skeleton);
+			Layout(arena.data());
+			skeleton.Reset();
+		}
+
+		return *this;
+	}
+
+	//makes room for bonesCapacity bones, so adding them does not move the arena
+	void Reserve(int bonesCapacity)
+	{
+		if (bonesCapacity <= capacity)
+			return;
+
+		Skeleton grown;
+		grown.bonesNum = bonesNum;
+		grown.capacity = bonesCapacity;
+		grown.arena.resize(grown.Layout(NULL));
+		grown.Layout(grown.arena.data());
+
+		grown.parentIndices = parentIndices;
+		grown.rotations = rotations;
+		grown.boneLengths = boneLengths;
+		grown.constraintsMin = constraintsMin;
+		grown.constraintsMax = constraintsMax;
+		grown.worldTransforms = worldTransforms;
+		grown.orientations = orientations;
+		grown.swingLimits = swingLimits;
+		grown.twistLimits = twistLimits;
+
+		arena.swap(grown.arena);
+		capacity = bonesCapacity;
+		Layout(arena.data());
+	}
+
+	int AddBone(int parentIndex, float length)
+	{
+		if (bonesNum == capacity)
+			Reserve(std::max(capacity * 2, SKELETON_MIN_CAPACITY));
+
+		int index = bonesNum++;
+		Layout(arena.data());
+
+		parentIndices[index] = parentIndex;
+		rotations[index] = glm::vec3(0.0f);
+		boneLengths[index] = length;
+		constraintsMin[index] = glm::vec3(-360.0f);
+		constraintsMax[index] = glm::vec3(360.0f);
+		worldTransforms[index] = glm::mat4(1.0f);
+		orientations[index] = glm::quat();
+		swingLimits[index] = glm::pi<float>();
+		twistLimits[index] = glm::vec2(-glm::pi<float>(), glm::pi<float>());
+
+		return index;
+	}
+
+	int Size() const
+	{
+		return bonesNum;
+	}
+
+	//creates new bone tree with the same structure and angles, returns its root, which owns the tree,
+	//bones hold Euler angles only, so the skeleton must not use quaternion joints
+	Bone* ToBones() const
+	{
+		assert(!quaternionJoints);
+
+		std::vector<Bone*> bones(parentIndices.size());
+
+		for (size_t i = 0; i < parentIndices.size(); i++)
+		{
+			bones[i] = new Bone(boneLengths[i]);
+			bones[i]->constraint[0] = constraintsMin[i];
+			bones[i]->constraint[1] = constraintsMax[i];
+
+			if (parentIndices[i] >= 0)
+				bones[parentIndices[i]]->AddChild(bones[i]);
+
+			bones[i]->SetRotate(rotations[i].x, rotations[i].y, rotations[i].z);
+		}
+
+		return bones.empty() ? NULL : bones[0];
+	}
+
+	//copies angles back to the bone tree this skeleton was built from, the skeleton must not use quaternion joints
+	void ApplyToBones(const std::vector<Bone*>& bones) const
+	{
+		assert(!quaternionJoints);
+
+		for (size_t i = 0; i < bones.size(); i++)
+			bones[i]->SetRotate(rotations[i].x, rotations[i].y, rotations[i].z);
+	}
+
+	//converts current angles to quaternion joints, per axis constraints are not carried over,
+	//swing and twist limits stay unlimited until they are set
+	void UseQuaternionJoints()
+	{
+		quaternionJoints = true;
+
+		for (size_t i = 0; i < rotations.size(); i++)
+			orientations[i] = glm::quat_cast(glm::mat3(Bone::CalcLocalTransform(rotations[i], 0.0f)));
+	}
+
+	void SetRotate(int index, float x, float y, float z)
+	{
+		rotations[index] = glm::vec3(fmod(x, 360.0f), fmod(y, 360.0f), fmod(z, 360.0f));
+
+		if (quaternionJoints)
+			orientations[index] = glm::quat_cast(glm::mat3(Bone::CalcLocalTransform(rotations[index], 0.0f)));
+	}
+
+	//delta holds angle changes around the axes returned by CalcJointAxes
+	void CheckConstrainsAndMax(int index, glm::vec3 delta)
+	{
+		if (quaternionJoints)
+		{
+			//with quaternion joints the axes are the parent bone axes, so delta is a rotation vector in the parent space
+			float angle = glm::length(delta);
+
+			if (angle > 0.0f)
+				RotateJoint(index, glm::angleAxis(angle, delta / angle));
+
+			return;
+		}
+
+		glm::vec3& rotation = rotations[index];
+
+		ClampAngleChanges(delta, rotation, constraintsMin[index], constraintsMax[index]);
+
+		SetRotate(index, rotation.x + delta.x, rotation.y + delta.y, rotation.z + delta.z);
+	}
+
+	//CheckConstrainsAndMax for count different bones, angleChanges holds three changes per bone,
+	//Euler joints are clamped IK_SIMD_WIDTH at a time, one pack per axis with a lane for every joint
+	void CheckConstrainsAndMax(const int* bones, const float* angleChanges, int count)
+	{
+		typedef FloatPack<IK_SIMD_WIDTH> Pack;
+
+		int i = 0;
+
+		for (; !quaternionJoints && i + IK_SIMD_WIDTH <= count; i += IK_SIMD_WIDTH)
+		{
+			float clamped[3][IK_SIMD_WIDTH];
+
+			for (int axis = 0; axis < 3; axis++)
+			{
+				float d[IK_SIMD_WIDTH], r[IK_SIMD_WIDTH], l[IK_SIMD_WIDTH], u[IK_SIMD_WIDTH];
+
+				for (int j = 0; j < IK_SIMD_WIDTH; j++)
+				{
+					int bone = bones[i + j];
+					d[j] = angleChanges[(i + j) * 3 + axis];
+					r[j] = rotations[bone][axis];
+					l[j] = constraintsMin[bone][axis];
+					u[j] = constraintsMax[bone][axis];
+				}
+
+				ClampAngleChange(Pack::Load(d), Pack::Load(r), Pack::Load(l), Pack::Load(u)).Store(clamped[axis]);
+			}
+
+			for (int j = 0; j < IK_SIMD_WIDTH; j++)
+			{
+				const glm::vec3& rotation = rotations[bones[i + j]];
+				SetRotate(bones[i + j], rotation.x + clamped[0][j], rotation.y + clamped[1][j], rotation.z + clamped[2][j]);
+			}
+		}
+
+		//quaternion joints and the remaining ones joint by joint
+		for (; i < count; i++)
+			CheckConstrainsAndMax(bones[i], glm::vec3(angleChanges[i * 3], angleChanges[i * 3 + 1], angleChanges[i * 3 + 2]));
+	}
+
+	//applies rotation given in the parent bone space to the quaternion joint and keeps it within swing and twist limits
+	void RotateJoint(int index, const glm::quat& rotation)
+	{
+		orientations[index] = ApplySwingTwistLimits(glm::normalize(rotation * orientations[index]), swingLimits[index], twistLimits[index]);
+	}
+
+	//rotates the bone so that its end points to the goal, transform of the parent must be up to date and only transform of this bone
+	//is updated, quaternion joints are turned by the shortest arc, Euler angle changes are found from the joint axes by damped least squares
+	void RotateTowards(int index, const glm::vec3& goal)
+	{
+		CalcTransform(index);
+
+		for (int step = 0; step < JOINT_FIT_STEPS; step++)
+		{
+			glm::vec3 startPosition = glm::vec3(GetBoneEnd(parentIndices[index]));
+			glm::vec3 dirToGoal = glm::normalize(goal - startPosition);
+			glm::vec3 dirToEndPos = glm::normalize(glm::vec3(GetBoneEnd(index)) - startPosition);
+
+			if (quaternionJoints)
+			{
+				glm::mat3 toParent = glm::transpose(glm::mat3(worldTransforms[parentIndices[index]]));
+				RotateJoint(index, glm::rotation(toParent * dirToEndPos, toParent * dirToGoal));
+				CalcTransform(index);
+				break; //shortest arc is exact, there is nothing to refine
+			}
+
+			glm::vec3 axis = glm::cross(dirToEndPos, dirToGoal);
+			float sinAngle = glm::length(axis);
+
+			if (sinAngle < 1e-6f)
+				break;
+
+			glm::vec3 angularChange = axis * (glm::atan(sinAngle, glm::dot(dirToEndPos, dirToGoal)) / sinAngle);
+
+			glm::vec3 axes[3];
+			CalcJointAxes(index, axes);
+
+			glm::mat3 jacobian(axes[0], axes[1], axes[2]);
+			glm::mat3 damped = jacobian * glm::transpose(jacobian) + glm::mat3(JOINT_FIT_DAMPING * JOINT_FIT_DAMPING);
+
+			CheckConstrainsAndMax(index, glm::transpose(jacobian) * (glm::inverse(damped) * angularChange));
+			CalcTransform(index);
+		}
+	}
+
+	//q = swing * twist, where twist is the rotation around the bone (Z axis) and swing moves the bone direction,
+	//these are the only limits of quaternion joints
+	static glm::quat ApplySwingTwistLimits(const glm::quat& q, float swingLimit, const glm::vec2& twistLimit)
+	{
+		bool limitTwist = twistLimit.x > -glm::pi<float>() || twistLimit.y < glm::pi<float>();
+		bool limitSwing = swingLimit < glm::pi<float>();
+
+		if (!limitTwist && !limitSwing)
+			return q;
+
+		//sign of the twist is chosen so that its angle is within [-pi, pi]
+		glm::quat twist(q.w, 0.0f, 0.0f, q.z);
+		float twistLength = glm::length(twist);
+		twist = twistLength > 1e-6f ? twist * ((q.w < 0.0f ? -1.0f : 1.0f) / twistLength) : glm::quat();
+
+		glm::quat swing = q * glm::conjugate(twist);
+
+		if (swing.w < 0.0f)
+			swing = -swing;
+
+		if (limitTwist)
+		{
+			float twistAngle = 2.0f * atan2(twist.z, twist.w);
+
+			if (twistAngle < twistLimit.x || twistAngle > twistLimit.y)
+				twist = glm::angleAxis(glm::clamp(twistAngle, twistLimit.x, twistLimit.y), Z_AXIS_3);
+		}
+
+		//swing angle is compared by the cosine of its half
+		if (limitSwing && swing.w < cos(swingLimit * 0.5f))
+		{
+			glm::vec3 axis(swing.x, swing.y, swing.z);
+			float axisLength = glm::length(axis);
+
+			if (axisLength > 0.0f)
+				swing = glm::angleAxis(swingLimit, axis / axisLength);
+		}
+
+		return swing * twist;
+	}
+
+	//forward kinematics for the whole skeleton in one pass
+	void CalcTransforms()
+	{
+		for (size_t i = 0; i < parentIndices.size(); i++)
+			CalcTransform((int)i);
+	}
+
+	void CalcTransform(int index)
+	{
+		int parentIndex = parentIndices[index];
+
+		if (parentIndex >= 0 && quaternionJoints)
+		{
+			glm::mat4 localTransform = glm::mat4_cast(orientations[index]);
+			localTransform[3] = glm::vec4(Z_AXIS_3 * boneLengths[parentIndex], 1.0f);
+			worldTransforms[index] = worldTransforms[parentIndex] * localTransform;
+		}
+		else if (parentIndex >= 0)
+			worldTransforms[index] = worldTransforms[parentIndex] * Bone::CalcLocalTransform(rotations[index], boneLengths[parentIndex]);
+		else
+			worldTransforms[index] = rootTransform;
+	}
+
+	//uses world transforms calculated by the last FK pass
+	glm::vec4 GetBoneEnd(int index) const
+	{
+		return glm::translate(worldTransforms[index], Z_AXIS_3 * boneLengths[index]) * W_AXIS_4;
+	}
+
+	//world space axes the bone rotates around when each of its three angles changes, bone start is the pivot
+	void CalcJointAxes(int index, glm::vec3 axes[3]) const
+	{
+		glm::mat3 parentRotation(worldTransforms[parentIndices[index]]);
+
+		if (quaternionJoints)
+		{
+			for (int i = 0; i < 3; i++)
+				axes[i] = parentRotation[i];
+
+			return;
+		}
+
+		Bone::CalcLocalRotationAxes(rotations[index], axes);
+
+		for (int i = 0; i < 3; i++)
+			axes[i] = parentRotation * axes[i];
+	}
+
+	//indices of bones from the root to the given bone
+	void GetChain(int endIndex, std::vector<int>& chain) const
+	{
+		chain.clear();
+
+		for (int i = endIndex; i >= 0; i = parentIndices[i])
+			chain.push_back(i);
+
+		std::reverse(chain.begin(), chain.end());
+	}
+
+	//rotates bones of the chain ending with endEffectorIndex so that its end reaches the target,
+	//returns true if target was reached within epsilon, iterationsNum receives number of iterations used
+	bool SolveCCD(int endEffectorIndex, const glm::vec3& target, int maxIterations, float epsilon, int* iterationsNum = NULL, std::vector<float>* residuals = NULL)
+	{
+		std::vector<int>& chain = ccdChain;
+		GetChain(endEffectorIndex, chain);
+
+		for (size_t i = 0; i < chain.size(); i++)
+			CalcTransform(chain[i]);
+
+		for (int i = 0; i < maxIterations; i++)
+		{
+			//walking from the end effector to the root, root bone itself is never rotated
+			for (int c = (int)chain.size() - 1; c > 0; c--)
+			{
+				int currentBone = chain[c];
+
+				glm::vec3 startPosition = glm::vec3(GetBoneEnd(chain[c - 1]));
+				glm::vec3 endPosition = glm::vec3(GetBoneEnd(currentBone));
+
+				glm::vec3 dirToTarget = glm::normalize(target - startPosition);
+				glm::vec3 dirToEndPos = glm::normalize(endPosition - startPosition);
+
+				if (glm::dot(dirToEndPos, dirToTarget) < 0.99f)
+				{
+					if (quaternionJoints)
+					{
+						//shortest arc in the parent space, no Euler angles and no trigonometry
+						glm::mat3 toParent = glm::transpose(glm::mat3(worldTransforms[chain[c - 1]]));
+						RotateJoint(currentBone, glm::rotation(toParent * dirToEndPos, toParent * dirToTarget));
+					}
+					else
+					{
+						float angle = glm::angle(dirToTarget, dirToEndPos);
+						glm::quat rotation = normalize(glm::angleAxis(angle, cross(dirToEndPos, dirToTarget)));
+						glm::vec3 euler = glm::eulerAngles(rotation);
+						CheckConstrainsAndMax(currentBone, euler);
+					}
+
+					//only the changed bone and bones below it in the chain are outdated
+					for (size_t k = c; k < chain.size(); k++)
+						CalcTransform(chain[k]);
+				}
+
+				glm::vec3 differnce = glm::vec3(GetBoneEnd(endEffectorIndex)) - target;
+				float squaredDistance = dot(differnce, differnce);
+
+				//distance after the whole pass or after the bone that reached the target
+				if (residuals != NULL && (c == 1 || squaredDistance < epsilon))
+					residuals->push_back(squaredDistance);
+
+				if (squaredDistance < epsilon)
+				{
+					if (iterationsNum != NULL)
+						*iterationsNum = i + 1;
+
+					return true;
+				}
+			}
+		}
+
+		if (iterationsNum != NULL)
+			*iterationsNum = maxIterations;
+
+		return false;
+	}
+
+private:
+	std::vector<glm::vec4> arena; //16 byte blocks, every array starts at the beginning of a block
+	int bonesNum;
+	int capacity;
+	std::vector<int> ccdChain; //scratch for SolveCCD, kept so that solving one iteration at a time does not allocate, never copied
+
+	//places arrays one after another in the arena (or only measures them if it is NULL), returns the arena size in blocks
+	size_t Layout(glm::vec4* base)
+	{
+		size_t offset = 0;
+		Place(parentIndices, base, offset);
+		Place(rotations, base, offset);
+		Place(boneLengths, base, offset);
+		Place(constraintsMin, base, offset);
+		Place(constraintsMax, base, offset);
+		Place(worldTransforms, base, offset);
+		Place(orientations, base, offset);
+		Place(swingLimits, base, offset);
+		Place(twistLimits, base, offset);
+
+		return offset;
+	}
+
+	template<typename T>
+	void Place(BoneArray<T>& array, glm::vec4* base, size_t& offset)
+	{
+		array.data = base != NULL ? reinterpret_cast<T*>(base + offset) : NULL;
+		array.count = bonesNum;
+		offset += (capacity * sizeof(T) + sizeof(glm::vec4) - 1) / sizeof(glm::vec4);
+	}
+
+	void CopySettings(const Skeleton& skeleton)
+	{
+		rootTransform = skeleton.rootTransform;
+		quaternionJoints = skeleton.quaternionJoints;
+		bonesNum = skeleton.bonesNum;
+		capacity = skeleton.capacity;
+	}
+
+	//empty skeleton left after its arena was moved away
+	void Reset()
+	{
+		arena.clear();
+		bonesNum = 0;
+		capacity = 0;
+		Layout(NULL);
+	}
+
+	void AddBoneTree(Bone* bone, int parentIndex, std::vector<Bone*>& order)
+	{
+		int index = AddBone(parentIndex, bone->boneLength);
+		rotations[index] = bone->rotation;
+		constraintsMin[index] = bone->constraint[0];
+		constraintsMax[index] = bone->constraint[1];
+		order.push_back(bone);
+
+		for (auto it = bone->childrenBones.begin(); it != bone->childrenBones.end(); ++it)
+			AddBoneTree(*it, index, order);
+	}
+};
+
+#endif
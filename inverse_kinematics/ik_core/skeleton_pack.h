@@ -0,0 +1,327 @@
+#ifndef SKELETON_PACK_HEADER
+#define SKELETON_PACK_HEADER
+
+#include <vector>
+#include "float_pack.h"
+#include "skeleton.h"
+
+//W skeletons of the same topology solved in lockstep, every lane of a pack holds value of one skeleton,
+//math follows the order of operations of glm used by Skeleton, only trigonometry is approximated,
+//so results match the scalar solver within float precision, only Euler joints are supported,
+//with IK_SIMD_EXACT_TRIG the C library trigonometry is used and the results are the same as the scalar ones
+template<int W>
+class SkeletonPack
+{
+public:
+	typedef FloatPack<W> Pack;
+	typedef typename Pack::Mask Mask;
+
+	struct Vec3
+	{
+		Pack x, y, z;
+	};
+
+	struct Mat4
+	{
+		Pack m[4][4]; //column major as in glm
+	};
+
+	//topology, lengths, limits and root placement are shared by all lanes
+	std::vector<int> parentIndices;
+	std::vector<float> boneLengths;
+	std::vector<glm::vec3> constraintsMin;
+	std::vector<glm::vec3> constraintsMax;
+	glm::mat4 rootTransform;
+
+	std::vector<Vec3, PackAllocator<Vec3> > rotations;
+	std::vector<Mat4, PackAllocator<Mat4> > worldTransforms;
+
+	//loads up to W skeletons, they all must have the same topology as the first one,
+	//returns false and loads nothing if any of them uses quaternion joints
+	bool Load(const Skeleton* skeletons, int count)
+	{
+		for (int l = 0; l < count; l++)
+			if (skeletons[l].quaternionJoints)
+				return false;
+
+		const Skeleton& s = skeletons[0];
+		parentIndices.assign(s.parentIndices.begin(), s.parentIndices.end());
+		boneLengths.assign(s.boneLengths.begin(), s.boneLengths.end());
+		constraintsMin.assign(s.constraintsMin.begin(), s.constraintsMin.end());
+		constraintsMax.assign(s.constraintsMax.begin(), s.constraintsMax.end());
+		rootTransform = s.rootTransform;
+		rotations.resize(s.Size());
+		worldTransforms.resize(s.Size());
+		lanesNum = count;
+
+		for (int b = 0; b < s.Size(); b++)
+		{
+			float x[W], y[W], z[W];
+
+			//unused lanes repeat the last skeleton
+			for (int l = 0; l < W; l++)
+			{
+				const glm::vec3& r = skeletons[l < count ? l : count - 1].rotations[b];
+				x[l] = r.x;
+				y[l] = r.y;
+				z[l] = r.z;
+			}
+
+			rotations[b].x = Pack::Load(x);
+			rotations[b].y = Pack::Load(y);
+			rotations[b].z = Pack::Load(z);
+		}
+
+		return true;
+	}
+
+	void Store(Skeleton* skeletons) const
+	{
+		for (int b = 0; b < (int)rotations.size(); b++)
+		{
+			float x[W], y[W], z[W];
+			rotations[b].x.Store(x);
+			rotations[b].y.Store(y);
+			rotations[b].z.Store(z);
+
+			for (int l = 0; l < lanesNum; l++)
+				skeletons[l].rotations[b] = glm::vec3(x[l], y[l], z[l]);
+		}
+
+		for (int l = 0; l < lanesNum; l++)
+			skeletons[l].CalcTransforms();
+	}
+
+	void CalcTransform(int index)
+	{
+		int parentIndex = parentIndices[index];
+
+		if (parentIndex < 0)
+		{
+			for (int c = 0; c < 4; c++)
+				for (int r = 0; r < 4; r++)
+					worldTransforms[index].m[c][r] = Pack(rootTransform[c][r]);
+
+			return;
+		}
+
+		//same as Bone::CalcLocalTransform
+		Mat4 local;
+
+		for (int c = 0; c < 4; c++)
+			for (int r = 0; r < 4; r++)
+				local.m[c][r] = Pack(c == r ? 1.0f : 0.0f);
+
+		local.m[3][2] = Pack(boneLengths[parentIndex]);
+
+		const Vec3& rotation = rotations[index];
+		Rotate(local, rotation.x, 0);
+		Rotate(local, rotation.y, 1);
+		Rotate(local, rotation.z, 2);
+
+		Multiply(worldTransforms[parentIndex], local, worldTransforms[index]);
+	}
+
+	Vec3 GetBoneEnd(int index) const
+	{
+		const Mat4& t = worldTransforms[index];
+		Pack length(boneLengths[index]);
+
+		Vec3 end;
+		end.x = t.m[2][0] * length + t.m[3][0];
+		end.y = t.m[2][1] * length + t.m[3][1];
+		end.z = t.m[2][2] * length + t.m[3][2];
+
+		return end;
+	}
+
+	//lockstep version of Skeleton::SolveCCD, lanes that reached their target are masked out of further updates
+	void SolveCCD(int endEffectorIndex, const glm::vec3* targets, int maxIterations, float epsilon, bool* converged)
+	{
+		std::vector<int> chain;
+		for (int i = endEffectorIndex; i >= 0; i = parentIndices[i])
+			chain.push_back(i);
+		std::reverse(chain.begin(), chain.end());
+
+		for (size_t i = 0; i < chain.size(); i++)
+			CalcTransform(chain[i]);
+
+		float tx[W], ty[W], tz[W];
+		bool used[W];
+
+		for (int l = 0; l < W; l++)
+		{
+			const glm::vec3& t = targets[l < lanesNum ? l : lanesNum - 1];
+			tx[l] = t.x;
+			ty[l] = t.y;
+			tz[l] = t.z;
+			used[l] = l < lanesNum;
+		}
+
+		Vec3 target;
+		target.x = Pack::Load(tx);
+		target.y = Pack::Load(ty);
+		target.z = Pack::Load(tz);
+
+		Mask active = Pack::MakeMask(used);
+		Mask reached = AndNot(active, active);
+
+		for (int i = 0; i < maxIterations && Any(active); i++)
+		{
+			for (int c = (int)chain.size() - 1; c > 0 && Any(active); c--)
+			{
+				int currentBone = chain[c];
+
+				Vec3 startPosition = GetBoneEnd(chain[c - 1]);
+				Vec3 endPosition = GetBoneEnd(currentBone);
+
+				Vec3 dirToTarget = Normalize(Sub(target, startPosition));
+				Vec3 dirToEndPos = Normalize(Sub(endPosition, startPosition));
+
+				Mask rotate = active & Less(Dot(dirToEndPos, dirToTarget), Pack(0.99f));
+
+				if (Any(rotate))
+				{
+					Pack angle = Acos(Clamp(Dot(dirToTarget, dirToEndPos), -1.0f, 1.0f));
+					Vec3 axis = Cross(dirToEndPos, dirToTarget);
+
+					//glm::angleAxis followed by glm::normalize
+					Pack s, qw;
+					SinCos(angle * Pack(0.5f), s, qw);
+					Pack qx = axis.x * s;
+					Pack qy = axis.y * s;
+					Pack qz = axis.z * s;
+
+					Pack length = Sqrt((qx * qx + qy * qy) + (qz * qz + qw * qw));
+					Mask valid = Greater(length, Pack(0.0f));
+					Pack oneOverLength = Pack(1.0f) / length;
+					qw = Select(valid, qw * oneOverLength, Pack(1.0f));
+					qx = Select(valid, qx * oneOverLength, Pack(0.0f));
+					qy = Select(valid, qy * oneOverLength, Pack(0.0f));
+					qz = Select(valid, qz * oneOverLength, Pack(0.0f));
+
+					//glm::eulerAngles
+					Vec3 euler;
+					euler.x = Atan2(Pack(2.0f) * (qy * qz + qw * qx), qw * qw - qx * qx - qy * qy + qz * qz);
+					euler.y = Asin(Clamp(Pack(-2.0f) * (qx * qz - qw * qy), -1.0f, 1.0f));
+					euler.z = Atan2(Pack(2.0f) * (qx * qy + qw * qz), qw * qw + qx * qx - qy * qy - qz * qz);
+
+					CheckConstrainsAndMax(currentBone, euler, rotate);
+
+					for (size_t k = c; k < chain.size(); k++)
+						CalcTransform(chain[k]);
+				}
+
+				Vec3 differnce = Sub(GetBoneEnd(endEffectorIndex), target);
+				Mask newlyReached = active & Less(Dot(differnce, differnce), Pack(epsilon));
+
+				reached = reached | newlyReached;
+				active = AndNot(active, newlyReached);
+			}
+		}
+
+		for (int l = 0; l < lanesNum; l++)
+			converged[l] = reached.Lane(l);
+	}
+
+private:
+	int lanesNum;
+
+	static Vec3 Sub(const Vec3& a, const Vec3& b)
+	{
+		Vec3 r;
+		r.x = a.x - b.x;
+		r.y = a.y - b.y;
+		r.z = a.z - b.z;
+		return r;
+	}
+
+	static Pack Dot(const Vec3& a, const Vec3& b)
+	{
+		return a.x * b.x + a.y * b.y + a.z * b.z;
+	}
+
+	static Vec3 Cross(const Vec3& a, const Vec3& b)
+	{
+		Vec3 r;
+		r.x = a.y * b.z - b.y * a.z;
+		r.y = a.z * b.x - b.z * a.x;
+		r.z = a.x * b.y - b.x * a.y;
+		return r;
+	}
+
+	static Vec3 Normalize(const Vec3& v)
+	{
+		Pack inverseLength = Pack(1.0f) / Sqrt(Dot(v, v));
+
+		Vec3 r;
+		r.x = v.x * inverseLength;
+		r.y = v.y * inverseLength;
+		r.z = v.z * inverseLength;
+		return r;
+	}
+
+	//glm::rotate around the given column of m
+	static void Rotate(Mat4& m, const Pack& angle, int axisColumn)
+	{
+		Pack s, c;
+		SinCos(angle, s, c);
+
+		Vec3 axis;
+		axis.x = m.m[axisColumn][0];
+		axis.y = m.m[axisColumn][1];
+		axis.z = m.m[axisColumn][2];
+		axis = Normalize(axis);
+
+		Pack oneMinusC = Pack(1.0f) - c;
+		Pack temp[3] = { oneMinusC * axis.x, oneMinusC * axis.y, oneMinusC * axis.z };
+
+		Pack rotate[3][3];
+		rotate[0][0] = c + temp[0] * axis.x;
+		rotate[0][1] = temp[0] * axis.y + s * axis.z;
+		rotate[0][2] = temp[0] * axis.z - s * axis.y;
+
+		rotate[1][0] = temp[1] * axis.x - s * axis.z;
+		rotate[1][1] = c + temp[1] * axis.y;
+		rotate[1][2] = temp[1] * axis.z + s * axis.x;
+
+		rotate[2][0] = temp[2] * axis.x + s * axis.y;
+		rotate[2][1] = temp[2] * axis.y - s * axis.x;
+		rotate[2][2] = c + temp[2] * axis.z;
+
+		Pack result[3][4];
+
+		for (int col = 0; col < 3; col++)
+			for (int r = 0; r < 4; r++)
+				result[col][r] = m.m[0][r] * rotate[col][0] + m.m[1][r] * rotate[col][1] + m.m[2][r] * rotate[col][2];
+
+		for (int col = 0; col < 3; col++)
+			for (int r = 0; r < 4; r++)
+				m.m[col][r] = result[col][r];
+	}
+
+	static void Multiply(const Mat4& a, const Mat4& b, Mat4& result)
+	{
+		for (int col = 0; col < 4; col++)
+			for (int r = 0; r < 4; r++)
+				result.m[col][r] = a.m[0][r] * b.m[col][0] + a.m[1][r] * b.m[col][1] + a.m[2][r] * b.m[col][2] + a.m[3][r] * b.m[col][3];
+	}
+
+	void CheckConstrainsAndMax(int index, const Vec3& delta, const Mask& mask)
+	{
+		Vec3& rotation = rotations[index];
+		const glm::vec3& constraintMin = constraintsMin[index];
+		const glm::vec3& constraintMax = constraintsMax[index];
+
+		Pack dx = ClampAngleChange(delta.x, rotation.x, Pack(constraintMin.x), Pack(constraintMax.x));
+		Pack dy = ClampAngleChange(delta.y, rotation.y, Pack(constraintMin.y), Pack(constraintMax.y));
+		Pack dz = ClampAngleChange(delta.z, rotation.z, Pack(constraintMin.z), Pack(constraintMax.z));
+
+		Pack full(360.0f);
+		rotation.x = Select(mask, Map(rotation.x + dx, full, fmodf), rotation.x);
+		rotation.y = Select(mask, Map(rotation.y + dy, full, fmodf), rotation.y);
+		rotation.z = Select(mask, Map(rotation.z + dz, full, fmodf), rotation.z);
+	}
+};
+
+#endif
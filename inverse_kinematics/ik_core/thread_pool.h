@@ -0,0 +1,139 @@
+#ifndef THREAD_POOL_HEADER
+#define THREAD_POOL_HEADER
+
+#include <vector>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <condition_variable>
+
+//fixed set of worker threads that run ParallelFor jobs, the calling thread works on the job too
+class ThreadPool
+{
+public:
+	//0 means one thread per hardware core
+	ThreadPool(int threadsNum = 0)
+	{
+		if (threadsNum <= 0)
+			threadsNum = std::max(1, (int)std::thread::hardware_concurrency());
+
+		stop = false;
+		job = NULL;
+		jobId = 0;
+		activeWorkers = 0;
+		itemsNum = 0;
+		chunkSize = 1;
+
+		for (int i = 0; i < threadsNum - 1; i++)
+			workers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+	}
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+
+		jobStarted.notify_all();
+
+		for (auto it = workers.begin(); it != workers.end(); ++it)
+			it->join();
+	}
+
+	int ThreadsNum() const
+	{
+		return (int)workers.size() + 1;
+	}
+
+	//calls func(i) for every i in [0, count) and returns when all calls are finished,
+	//items are handed out in chunks through an atomic counter so threads never wait on each other
+	void ParallelFor(int count, const std::function<void(int)>& func)
+	{
+		if (count <= 0)
+			return;
+
+		if (workers.empty())
+		{
+			for (int i = 0; i < count; i++)
+				func(i);
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &func;
+			itemsNum = count;
+			chunkSize = std::max(1, count / (ThreadsNum() * 8));
+			nextItem = 0;
+			activeWorkers = (int)workers.size();
+			jobId++;
+		}
+
+		jobStarted.notify_all();
+
+		RunItems();
+
+		std::unique_lock<std::mutex> lock(mutex);
+		jobFinished.wait(lock, [this] { return activeWorkers == 0; });
+		job = NULL;
+	}
+
+private:
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobStarted;
+	std::condition_variable jobFinished;
+	const std::function<void(int)>* job;
+	std::atomic<int> nextItem;
+	int itemsNum;
+	int chunkSize;
+	int activeWorkers;
+	unsigned int jobId;
+	bool stop;
+
+	void RunItems()
+	{
+		for (;;)
+		{
+			int first = nextItem.fetch_add(chunkSize);
+
+			if (first >= itemsNum)
+				break;
+
+			int last = std::min(first + chunkSize, itemsNum);
+
+			for (int i = first; i < last; i++)
+				(*job)(i);
+		}
+	}
+
+	void WorkerLoop()
+	{
+		unsigned int lastJobId = 0;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobStarted.wait(lock, [this, lastJobId] { return stop || jobId != lastJobId; });
+
+				if (stop)
+					return;
+
+				lastJobId = jobId;
+			}
+
+			RunItems();
+
+			std::lock_guard<std::mutex> lock(mutex);
+
+			if (--activeWorkers == 0)
+				jobFinished.notify_one();
+		}
+	}
+};
+
+#endif
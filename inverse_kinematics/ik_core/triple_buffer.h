@@ -0,0 +1,55 @@
+#ifndef TRIPLE_BUFFER_HEADER
+#define TRIPLE_BUFFER_HEADER
+
+#include <atomic>
+
+#define TRIPLE_BUFFER_NEW 4 //set in the middle slot index when it holds data the reader has not taken yet
+
+//single writer, single reader exchange of the latest value without locks, the writer fills the back slot and publishes it
+//as the middle one, the reader takes the middle slot as its front one, neither of them ever waits for the other
+template<typename T>
+class TripleBuffer
+{
+public:
+	TripleBuffer()
+	{
+		back = 0;
+		middle = 1;
+		front = 2;
+	}
+
+	//writer side, slot to fill before Publish
+	T& Back()
+	{
+		return slots[back];
+	}
+
+	void Publish()
+	{
+		back = middle.exchange(back | TRIPLE_BUFFER_NEW, std::memory_order_acq_rel) & ~TRIPLE_BUFFER_NEW;
+	}
+
+	//reader side, takes the last published value if there is one, returns true if front slot has changed
+	bool Update()
+	{
+		if ((middle.load(std::memory_order_relaxed) & TRIPLE_BUFFER_NEW) == 0)
+			return false;
+
+		front = middle.exchange(front, std::memory_order_acq_rel) & ~TRIPLE_BUFFER_NEW;
+
+		return true;
+	}
+
+	const T& Front() const
+	{
+		return slots[front];
+	}
+
+private:
+	T slots[3];
+	int back;
+	std::atomic<int> middle;
+	int front;
+};
+
+#endif
@@ -20,13 +20,31 @@
 #include <iostream>
 #include <map>
 #include <vector>
+#include <algorithm>
 #include "math_3d.h"
 
 #define MAX_BONES_NUM 100
 #define ANIMATION_NUM 0
 #define EPSILON 0.001f
+#define KEY_CURSOR_STEPS 4 // keys a cursor may move forward before the search falls back to binary search
+#define BAKED_FRAMES_PER_SECOND 30.0f // rate the played animation is resampled at when the model is loaded
 using namespace std;
 
+// keys used last time for each kind of keys of one animation channel, playback moves them forward by a key or two per frame
+struct ChannelCursors
+{
+	unsigned int ScalingKey;
+	unsigned int RotationKey;
+	unsigned int PositionKey;
+
+	ChannelCursors()
+	{
+		ScalingKey = 0;
+		RotationKey = 0;
+		PositionKey = 0;
+	}
+};
+
 unsigned int TextureFromFile(const char *path, const string &directory, bool gamma = false);
 
 
@@ -46,12 +64,37 @@ public:
 	std::map<string, int> boneMapping;
 	std::vector<BoneInfo> boneInfoArray;
 	unsigned int bonesAmount;
+	std::vector<ChannelCursors> channelCursors; // one per channel of the played animation
+	// node hierarchy flattened in depth-first order, so every parent goes before its children, nodes that move no bone are left out
+	std::vector<int> nodeParents; // -1 for the root node
+	std::vector<Matrix4f> nodeTransforms; // relatively to the parent node, used when the node is not animated
+	std::vector<int> nodeChannels; // channel of the played animation, -1 if the node is not animated
+	std::vector<int> nodeBones; // -1 if the node is not a bone
+	std::vector<int> nodeBakedChannels; // column of the node in the baked tables, -1 if the node is not animated
+	std::vector<Matrix4f> nodeGlobalTransforms; // filled by CalcNodeTransforms
+	unsigned int bonesShaderID; // program bonesLocation was looked up in
+	GLint bonesLocation; // of the gBones array
+	// played animation resampled at BAKED_FRAMES_PER_SECOND, one array per kind of transform, frame after frame,
+	// all channels of a frame are next to each other, only channels of the flattened nodes are baked
+	float bakedFramesPerTick;
+	float bakedLastFrameTime; // in ticks, the last frame is closer to the one before it unless the animation lasts whole frames
+	unsigned int bakedFramesNum;
+	unsigned int bakedChannelsNum;
+	std::vector<aiVector3D> bakedScalings;
+	std::vector<aiQuaternion> bakedRotations;
+	std::vector<aiVector3D> bakedPositions;
 
     /*  Functions   */
     // constructor, expects a filepath to a 3D model.
     Model(string const &path, bool gamma = false) : gammaCorrection(gamma)
     {
 		bonesAmount = 0;
+		bonesShaderID = 0;
+		bonesLocation = -1;
+		bakedFramesPerTick = 0.0f;
+		bakedLastFrameTime = 0.0f;
+		bakedFramesNum = 0;
+		bakedChannelsNum = 0;
         loadModel(path);
     }
 
@@ -69,45 +112,39 @@ public:
     }
     void BoneTransform(Shader shader, float TimeInSeconds, vector<Matrix4f>& Transforms, vector<glm::vec4>& bonePositions)
     {
-        Matrix4f Identity;
-
-        Identity.InitIdentity();
         float TicksPerSecond = (float)(scene->mAnimations[ANIMATION_NUM]->mTicksPerSecond != 0 ? scene->mAnimations[ANIMATION_NUM]->mTicksPerSecond : 25.0f);
         float TimeInTicks = TimeInSeconds * TicksPerSecond;
         float AnimationTime = fmod(TimeInTicks, (float)scene->mAnimations[ANIMATION_NUM]->mDuration);
 
-        ReadNodeHeirarchy(AnimationTime, scene->mRootNode, Identity);
+        CalcNodeTransforms(AnimationTime);
+
+        // the shader has room for MAX_BONES_NUM bones, vertices never refer to the entries above bonesAmount
+        unsigned int UploadedBones = std::min(bonesAmount, (unsigned int)MAX_BONES_NUM);
 
-        Transforms.resize(100);
+        Transforms.resize(UploadedBones);
         bonePositions.resize(bonesAmount);
-        
-        std::vector<Vector4f> BonePositionsMeshSpace;
-        BonePositionsMeshSpace.reserve(bonesAmount);
 
         for (unsigned int i = 0; i < bonesAmount; i++) {
-            Transforms[i] = boneInfoArray[i].FinalTransformation;
+            if (i < UploadedBones) {
+                Transforms[i] = boneInfoArray[i].FinalTransformation;
+            }
 
-            BonePositionsMeshSpace.push_back(boneInfoArray[i].BonePosition * Vector4f(0, 0, 0, 1));
-            bonePositions[i][0] = BonePositionsMeshSpace[i].x;
-            bonePositions[i][1] = BonePositionsMeshSpace[i].y;
-            bonePositions[i][2] = BonePositionsMeshSpace[i].z;
+            Vector4f BonePositionMeshSpace = boneInfoArray[i].BonePosition * Vector4f(0, 0, 0, 1);
+            bonePositions[i][0] = BonePositionMeshSpace.x;
+            bonePositions[i][1] = BonePositionMeshSpace.y;
+            bonePositions[i][2] = BonePositionMeshSpace.z;
             bonePositions[i][3] = 1.0f;
         }
 
-        for (unsigned int i = bonesAmount; i < 100; i++) {
-            Transforms[i].InitIdentity();
+        // location is looked up once per shader program, the whole palette goes in one call
+        if (shader.ID != bonesShaderID) {
+            bonesShaderID = shader.ID;
+            bonesLocation = glGetUniformLocation(shader.ID, "gBones");
         }
 
-        for (int i = 0; i < Transforms.size(); i++)
-        {
-            char Name[128];
-            memset(Name, 0, sizeof(Name));
-            _snprintf_s(Name, sizeof(Name), "gBones[%d]", i);
-            GLuint boneLocation = glGetUniformLocation(shader.ID, Name);
-
-            glUniformMatrix4fv(boneLocation, 1, GL_TRUE, Transforms[i]);
+        if (UploadedBones > 0) {
+            glUniformMatrix4fv(bonesLocation, UploadedBones, GL_TRUE, Transforms[0]);
         }
-
     }
 
     
@@ -130,12 +167,22 @@ private:
 
         globalInverseTransform = inversed;
 
+        if (scene->mNumAnimations > ANIMATION_NUM)
+            channelCursors.resize(scene->mAnimations[ANIMATION_NUM]->mNumChannels);
+
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 		numVertices = 0;
 
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        // bones are known once all meshes are processed
+        FlattenNodes(scene->mRootNode, -1);
+        nodeGlobalTransforms.resize(nodeParents.size());
+
+        if (scene->mNumAnimations > ANIMATION_NUM)
+            BakeAnimation();
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -326,77 +373,182 @@ private:
         return textures;
     }
 
-	void ReadNodeHeirarchy(float AnimationTime, const aiNode* pNode, const Matrix4f& ParentTransform)
+	// appends the node and its subtree in depth-first order and resolves node names to channels and bones, so animating
+	// the hierarchy does no string work, a node without bones in its subtree moves no bone and is left out, returns true if it was kept
+	bool FlattenNodes(const aiNode* pNode, int Parent)
 	{
 		string NodeName(pNode->mName.data);
+		map<string, int>::const_iterator Bone = boneMapping.find(NodeName);
+		int Index = (int)nodeParents.size();
+		Matrix4f Transform = pNode->mTransformation;
+
+		nodeParents.push_back(Parent);
+		nodeTransforms.push_back(Transform);
+		nodeChannels.push_back(scene->mNumAnimations > ANIMATION_NUM ? FindChannel(scene->mAnimations[ANIMATION_NUM], NodeName) : -1);
+		nodeBones.push_back(Bone != boneMapping.end() ? Bone->second : -1);
+
+		bool HasBones = nodeBones[Index] >= 0;
+
+		for (unsigned int i = 0; i < pNode->mNumChildren; i++) {
+			if (FlattenNodes(pNode->mChildren[i], Index)) {
+				HasBones = true;
+			}
+		}
+
+		// children without bones have already removed themselves, so the node is the last one
+		if (!HasBones) {
+			nodeParents.pop_back();
+			nodeTransforms.pop_back();
+			nodeChannels.pop_back();
+			nodeBones.pop_back();
+		}
+
+		return HasBones;
+	}
 
+	// resamples the channels of the flattened nodes at a fixed rate from their keys, so sampling a frame needs no key search
+	// and no slerp, only two table reads and a blend per channel
+	void BakeAnimation()
+	{
 		const aiAnimation* pAnimation = scene->mAnimations[ANIMATION_NUM];
+		float TicksPerSecond = (float)(pAnimation->mTicksPerSecond != 0 ? pAnimation->mTicksPerSecond : 25.0f);
 
-		Matrix4f NodeTransformation;
-		
-        NodeTransformation = pNode->mTransformation;
+		// channels of pruned nodes move no bone and get no column
+		std::vector<unsigned int> BakedChannels;
+		std::vector<int> ChannelColumns(pAnimation->mNumChannels, -1);
+		nodeBakedChannels.resize(nodeChannels.size());
 
-		const aiNodeAnim* pNodeAnim = FindNodeAnim(pAnimation, NodeName);
+		for (size_t Index = 0; Index < nodeChannels.size(); Index++) {
+			int Channel = nodeChannels[Index];
 
-		if (pNodeAnim)
-		{
-			// Interpolate scaling and generate scaling transformation matrix
-			aiVector3D Scaling;
-			CalcInterpolatedScaling(Scaling, AnimationTime, pNodeAnim);
-            Matrix4f ScalingM;
-            ScalingM.InitScaleTransform(Scaling.x, Scaling.y, Scaling.z);
-
-			// Interpolate rotation and generate rotation transformation matrix
-            aiQuaternion Q;
-            CalcInterpolatedRotation(Q, AnimationTime, pNodeAnim);
-            Matrix4f RotationM = Matrix4f(Q.GetMatrix());
-
-			// Interpolate translation and generate translation transformation matrix
-			aiVector3D Translation;
-			CalcInterpolatedPosition(Translation, AnimationTime, pNodeAnim);
-            Matrix4f TranslationM;
-            TranslationM.InitTranslationTransform(Translation.x, Translation.y, Translation.z);
-
-			//cout << Translation.x << " " << Translation.y << " " << Translation.z << endl;
-			//cout << Scaling.x << " " << Scaling.y << " " << Scaling.z << endl;
-			// Combine the above transformations
-			NodeTransformation = TranslationM * RotationM * ScalingM;
+			if (Channel >= 0 && ChannelColumns[Channel] < 0) {
+				ChannelColumns[Channel] = (int)BakedChannels.size();
+				BakedChannels.push_back(Channel);
+			}
+
+			nodeBakedChannels[Index] = Channel >= 0 ? ChannelColumns[Channel] : -1;
 		}
 
-		Matrix4f GlobalTransformation = ParentTransform * NodeTransformation;
-        
-		if (boneMapping.find(NodeName) != boneMapping.end()) {
-			unsigned int BoneIndex = boneMapping[NodeName];
-			boneInfoArray[BoneIndex].FinalTransformation = globalInverseTransform * GlobalTransformation * boneInfoArray[BoneIndex].BoneOffset;
-            boneInfoArray[BoneIndex].BonePosition = globalInverseTransform * GlobalTransformation;
+		bakedChannelsNum = (unsigned int)BakedChannels.size();
+		bakedFramesPerTick = BAKED_FRAMES_PER_SECOND / TicksPerSecond;
+		bakedFramesNum = (unsigned int)ceil((float)pAnimation->mDuration * bakedFramesPerTick) + 1;
+		// the played time never reaches mDuration, the last frame is taken just before it, where the keys are still interpolated
+		bakedLastFrameTime = nextafterf((float)pAnimation->mDuration, 0.0f);
+		bakedScalings.resize(bakedFramesNum * bakedChannelsNum);
+		bakedRotations.resize(bakedFramesNum * bakedChannelsNum);
+		bakedPositions.resize(bakedFramesNum * bakedChannelsNum);
+
+		for (unsigned int Frame = 0; Frame < bakedFramesNum; Frame++) {
+			float Time = GetBakedFrameTime(Frame);
+
+			for (unsigned int Column = 0; Column < bakedChannelsNum; Column++) {
+				unsigned int Channel = BakedChannels[Column];
+				const aiNodeAnim* pNodeAnim = pAnimation->mChannels[Channel];
+				ChannelCursors& Cursors = channelCursors[Channel];
+				unsigned int Index = Frame * bakedChannelsNum + Column;
+
+				CalcInterpolatedScaling(bakedScalings[Index], Time, pNodeAnim, Cursors);
+				CalcInterpolatedRotation(bakedRotations[Index], Time, pNodeAnim, Cursors);
+				CalcInterpolatedPosition(bakedPositions[Index], Time, pNodeAnim, Cursors);
+			}
 		}
+	}
 
-		for (unsigned int i = 0; i < pNode->mNumChildren; i++) {
-			ReadNodeHeirarchy(AnimationTime, pNode->mChildren[i], GlobalTransformation);
+	// time in ticks the baked frame was sampled at
+	float GetBakedFrameTime(unsigned int Frame) const
+	{
+		return std::min((float)Frame / bakedFramesPerTick, bakedLastFrameTime);
+	}
+
+	// global transforms of all nodes in one pass over the flattened hierarchy, parents are always done before their children,
+	// animated nodes are blended from the two baked frames around AnimationTime
+	void CalcNodeTransforms(float AnimationTime)
+	{
+		unsigned int Frame = std::min((unsigned int)(AnimationTime * bakedFramesPerTick), bakedFramesNum - 1);
+		unsigned int NextFrame = std::min(Frame + 1, bakedFramesNum - 1);
+
+		// factor comes from the frame times, as the last two frames are closer than the others
+		float FrameTime = GetBakedFrameTime(Frame);
+		float SegmentTime = GetBakedFrameTime(NextFrame) - FrameTime;
+		float Factor = SegmentTime > 0.0f ? std::min(std::max((AnimationTime - FrameTime) / SegmentTime, 0.0f), 1.0f) : 0.0f;
+
+		for (size_t Index = 0; Index < nodeParents.size(); Index++)
+		{
+			Matrix4f NodeTransformation = nodeTransforms[Index];
+
+			int Column = nodeBakedChannels[Index];
+
+			if (Column >= 0)
+			{
+				unsigned int Key = Frame * bakedChannelsNum + Column;
+				unsigned int NextKey = NextFrame * bakedChannelsNum + Column;
+
+				aiVector3D Scaling = bakedScalings[Key] + Factor * (bakedScalings[NextKey] - bakedScalings[Key]);
+				Matrix4f ScalingM;
+				ScalingM.InitScaleTransform(Scaling.x, Scaling.y, Scaling.z);
+
+				aiQuaternion Q = Nlerp(bakedRotations[Key], bakedRotations[NextKey], Factor);
+				Matrix4f RotationM = Matrix4f(Q.GetMatrix());
+
+				aiVector3D Translation = bakedPositions[Key] + Factor * (bakedPositions[NextKey] - bakedPositions[Key]);
+				Matrix4f TranslationM;
+				TranslationM.InitTranslationTransform(Translation.x, Translation.y, Translation.z);
+
+				// Combine the above transformations
+				NodeTransformation = TranslationM * RotationM * ScalingM;
+			}
+
+			int Parent = nodeParents[Index];
+			Matrix4f& GlobalTransformation = nodeGlobalTransforms[Index];
+			GlobalTransformation = Parent >= 0 ? nodeGlobalTransforms[Parent] * NodeTransformation : NodeTransformation;
+
+			int BoneIndex = nodeBones[Index];
+
+			if (BoneIndex >= 0) {
+				boneInfoArray[BoneIndex].FinalTransformation = globalInverseTransform * GlobalTransformation * boneInfoArray[BoneIndex].BoneOffset;
+				boneInfoArray[BoneIndex].BonePosition = globalInverseTransform * GlobalTransformation;
+			}
 		}
 	}
 
-	const aiNodeAnim* FindNodeAnim(const aiAnimation* pAnimation, const string NodeName)
+	// normalized linear blend along the shorter arc, baked frames are close enough for it to stay near slerp
+	static aiQuaternion Nlerp(const aiQuaternion& Start, const aiQuaternion& End, float Factor)
+	{
+		float Cosom = Start.x * End.x + Start.y * End.y + Start.z * End.z + Start.w * End.w;
+		float EndFactor = Cosom < 0.0f ? -Factor : Factor;
+		float StartFactor = 1.0f - Factor;
+
+		aiQuaternion Out;
+		Out.x = StartFactor * Start.x + EndFactor * End.x;
+		Out.y = StartFactor * Start.y + EndFactor * End.y;
+		Out.z = StartFactor * Start.z + EndFactor * End.z;
+		Out.w = StartFactor * Start.w + EndFactor * End.w;
+
+		return Out.Normalize();
+	}
+
+	// index of the channel animating the node, -1 if the node is not animated
+	int FindChannel(const aiAnimation* pAnimation, const string NodeName)
 	{
 		for (unsigned int i = 0; i < pAnimation->mNumChannels; i++) {
 			const aiNodeAnim* pNodeAnim = pAnimation->mChannels[i];
 
 			if (string(pNodeAnim->mNodeName.data) == NodeName) {
-				return pNodeAnim;
+				return (int)i;
 			}
 		}
 
-		return NULL;
+		return -1;
 	}
 
-	void CalcInterpolatedScaling(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
+	void CalcInterpolatedScaling(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim, ChannelCursors& Cursors)
 	{
 		if (pNodeAnim->mNumScalingKeys == 1) {
 			Out = pNodeAnim->mScalingKeys[0].mValue;
 			return;
 		}
 
-		unsigned int ScalingIndex = FindScaling(AnimationTime, pNodeAnim);
+		unsigned int ScalingIndex = FindScaling(AnimationTime, pNodeAnim, Cursors.ScalingKey);
 		unsigned int NextScalingIndex = (ScalingIndex + 1);
 		assert(NextScalingIndex < pNodeAnim->mNumScalingKeys);
 		float DeltaTime = (float)(pNodeAnim->mScalingKeys[NextScalingIndex].mTime - pNodeAnim->mScalingKeys[ScalingIndex].mTime);
@@ -408,22 +560,14 @@ private:
 		Out = Start + Factor * Delta;
 	}
 
-	unsigned int FindScaling(float AnimationTime, const aiNodeAnim* pNodeAnim)
+	unsigned int FindScaling(float AnimationTime, const aiNodeAnim* pNodeAnim, unsigned int& Cursor)
 	{
-		assert(pNodeAnim->mNumScalingKeys > 0);
+		assert(pNodeAnim->mNumScalingKeys > 1);
 
-		for (unsigned int i = 0; i < pNodeAnim->mNumScalingKeys - 1; i++) {
-			if (AnimationTime < (float)pNodeAnim->mScalingKeys[i + 1].mTime) {
-				return i;
-			}
-		}
-
-		assert(0);
-
-		return 0;
+		return FindKey(AnimationTime, pNodeAnim->mScalingKeys, pNodeAnim->mNumScalingKeys, Cursor);
 	}
 
-	void CalcInterpolatedRotation(aiQuaternion& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
+	void CalcInterpolatedRotation(aiQuaternion& Out, float AnimationTime, const aiNodeAnim* pNodeAnim, ChannelCursors& Cursors)
 	{
 		// we need at least two values to interpolate...
 		if (pNodeAnim->mNumRotationKeys == 1) {
@@ -431,7 +575,7 @@ private:
 			return;
 		}
 
-		unsigned int RotationIndex = FindRotation(AnimationTime, pNodeAnim);
+		unsigned int RotationIndex = FindRotation(AnimationTime, pNodeAnim, Cursors.RotationKey);
 		unsigned int NextRotationIndex = (RotationIndex + 1);
 		assert(NextRotationIndex < pNodeAnim->mNumRotationKeys);
 		float DeltaTime = (float)(pNodeAnim->mRotationKeys[NextRotationIndex].mTime - pNodeAnim->mRotationKeys[RotationIndex].mTime);
@@ -443,29 +587,21 @@ private:
 		Out = Out.Normalize();
 	}
 
-	unsigned int FindRotation(float AnimationTime, const aiNodeAnim* pNodeAnim)
+	unsigned int FindRotation(float AnimationTime, const aiNodeAnim* pNodeAnim, unsigned int& Cursor)
 	{
-		assert(pNodeAnim->mNumRotationKeys > 0);
-
-		for (unsigned int i = 0; i < pNodeAnim->mNumRotationKeys - 1; i++) {
-			if (AnimationTime < (float)pNodeAnim->mRotationKeys[i + 1].mTime) {
-				return i;
-			}
-		}
+		assert(pNodeAnim->mNumRotationKeys > 1);
 
-		assert(0);
-
-		return 0;
+		return FindKey(AnimationTime, pNodeAnim->mRotationKeys, pNodeAnim->mNumRotationKeys, Cursor);
 	}
 
-	void CalcInterpolatedPosition(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim)
+	void CalcInterpolatedPosition(aiVector3D& Out, float AnimationTime, const aiNodeAnim* pNodeAnim, ChannelCursors& Cursors)
 	{
 		if (pNodeAnim->mNumPositionKeys == 1) {
 			Out = pNodeAnim->mPositionKeys[0].mValue;
 			return;
 		}
 
-		unsigned int PositionIndex = FindPosition(AnimationTime, pNodeAnim);
+		unsigned int PositionIndex = FindPosition(AnimationTime, pNodeAnim, Cursors.PositionKey);
 		unsigned int NextPositionIndex = (PositionIndex + 1);
 		assert(NextPositionIndex < pNodeAnim->mNumPositionKeys);
 		float DeltaTime = (float)(pNodeAnim->mPositionKeys[NextPositionIndex].mTime - pNodeAnim->mPositionKeys[PositionIndex].mTime);
@@ -477,17 +613,48 @@ private:
 		Out = Start + Factor * Delta;
 	}
 
-	unsigned int FindPosition(float AnimationTime, const aiNodeAnim* pNodeAnim)
+	unsigned int FindPosition(float AnimationTime, const aiNodeAnim* pNodeAnim, unsigned int& Cursor)
+	{
+		assert(pNodeAnim->mNumPositionKeys > 1);
+
+		return FindKey(AnimationTime, pNodeAnim->mPositionKeys, pNodeAnim->mNumPositionKeys, Cursor);
+	}
+
+	// first key of the pair of keys around AnimationTime (the last pair past the last key), the search starts at the cursor,
+	// so playing forward costs a key or two, jumps back (looping) and far ahead fall back to binary search, cursor is updated
+	template<typename Key>
+	static unsigned int FindKey(float AnimationTime, const Key* pKeys, unsigned int NumKeys, unsigned int& Cursor)
 	{
-		for (unsigned int i = 0; i < pNodeAnim->mNumPositionKeys - 1; i++) {
-			if (AnimationTime < (float)pNodeAnim->mPositionKeys[i + 1].mTime) {
-				return i;
+		unsigned int Last = NumKeys - 2;
+		unsigned int i = std::min(Cursor, Last);
+
+		if (i == 0 || AnimationTime >= (float)pKeys[i].mTime) {
+			unsigned int End = std::min(i + KEY_CURSOR_STEPS, Last);
+
+			while (i < End && AnimationTime >= (float)pKeys[i + 1].mTime) {
+				i++;
+			}
+
+			if (i == Last || AnimationTime < (float)pKeys[i + 1].mTime) {
+				return Cursor = i;
 			}
 		}
 
-		assert(0);
+		unsigned int Low = 0;
+		unsigned int High = Last;
+
+		while (Low < High) {
+			unsigned int Middle = (Low + High) / 2;
+
+			if (AnimationTime < (float)pKeys[Middle + 1].mTime) {
+				High = Middle;
+			}
+			else {
+				Low = Middle + 1;
+			}
+		}
 
-		return 0;
+		return Cursor = Low;
 	}
 
     inline void InterpolateQ(aiQuaternion& result, const aiQuaternion& startRot, const aiQuaternion& endRot, float factor)
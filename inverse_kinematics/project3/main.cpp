@@ -13,7 +13,7 @@
 #include <freeglut.h>
 #include <GLFW/glfw3.h>
 
-#include "bone.h"
+#include "ik_async.h"
 
 #define WINDOW_WIDTH 800
 #define WINDOW_HEIGHT 800
@@ -35,33 +35,46 @@
 
 //defines for target movement control
 #define TARGET_CONTROL_SPEED 0.1f
-#define TARGET_HEIGHT_MAX_LIMIT 4.0f
-#define TARGET_HEIGHT_MIN_LIMIT 3.0f
-#define TARGET_WIDTH_LENGTH_LIMIT 3.0f //center of this constrain box is at 0.0
 #define ENABLE_HEIGHT_CAMERA_CONTROL 0
 
-#define CCD_ITERATIONS_NUM 1000
-#define EPSILON 0.001f
-
 void Update(void);
-void DrawSkeleton(Bone* bone);
+void BuildMeshes(void);
+void FindLeafBones(const Skeleton& skeleton, std::vector<char>& leafBones);
+void DrawSkeleton(const Skeleton& skeleton, const std::vector<char>& leafBones, const glm::mat4& viewTransform);
 void NextFrame(void);
 void OnKeyUp(unsigned char c, int x, int y);
 void OnKeyDown(unsigned char c, int x, int y);
 float DegreesToRadians(float angle);
 float RadiansToDegrees(float radians);
-void UpdateBonesAngles();
+void UpdateBonesAngles(IKSolverType solverType, int maxIterations);
+void ShowSolveResult(const IKSolveResult& result);
 
 glm::vec3 cameraAngle = glm::vec3(DegreesToRadians(CAMERA_INITIAL_ANGLE_X_AXIS), DegreesToRadians(CAMERA_INITIAL_ANGLE_Y_AXIS), DegreesToRadians(CAMERA_INITIAL_ANGLE_Z_AXIS));
-glm::vec3 targetPos = glm::vec3(0.0f, 1.5f, 0.0f);
 
 GLfloat lightAmbient[] = { 0.1, 0.1, 0.1, 1.0 };
 GLfloat lightPosition[] = { 1.0, 0.0, 0.0, 1.0 };
 GLfloat lightDiffuse[] = { 0.5, 0.5, 0.5, 1.0 };
 GLfloat lightSpecular[] = { 0.5, 0.5, 0.5, 1.0 };
 
-Bone* root;
-Bone* endEffector;
+//meshes compiled once into display lists, so drawing them neither tessellates nor allocates anything
+GLuint targetMesh;
+GLuint jointMesh;
+GLuint endEffectorMesh;
+GLuint boneMesh; //unit length, scaled along Z by the bone length when drawn
+
+//skeleton and target, the viewer only draws and edits them
+IKContext context;
+
+//bones without children, they carry the end effector, found once as the viewer never changes the skeleton topology
+std::vector<char> leafBones;
+
+//solves on its own thread with a copy of the context, solved poses are copied back to the context skeleton before drawing
+IKAsyncSolver asyncSolver;
+
+//in tracking mode the chain follows the target every frame instead of being solved on key press
+bool trackingMode = false;
+IKSolverType trackingSolver = IK_SOLVER_CCD;
+int trackingIterationsNum = CCD_ITERATIONS_NUM;
 
 int main(int argc, char* argv[])
 {
@@ -89,25 +102,37 @@ int main(int argc, char* argv[])
 	glEnable(GL_LIGHT1);
 	glEnable(GL_DEPTH_TEST);
 
+	BuildMeshes();
+
 	//creating bones structure
-	root = new Bone(0.0f);
-
-	endEffector = root->AddChild(new Bone(0.4f)) //1st bone
-				      ->AddChild(new Bone(0.4f))->SetRotate(0.0f,  10.0f, 0.0f) //2nd bone
-				      ->AddChild(new Bone(0.4f))->SetRotate(0.0f, -10.0f, 0.0f) //3nd bone
-				      ->AddChild(new Bone(0.4f))->SetRotate(0.0f,  10.0f, 0.0f) //4nd bone
-				      ->AddChild(new Bone(0.4f))->SetRotate(0.0f, -10.0f, 0.0f) //5th bone
-				      ->AddChild(new Bone(0.4f))->SetRotate(0.0f,  10.0f, 0.0f);//6th end effector bone
-				      
-	glutMainLoop();
+	Skeleton& skeleton = context.skeleton;
+	int bone = skeleton.AddBone(-1, 0.0f); //root
+
+	bone = skeleton.AddBone(bone, 0.4f); //1st bone
+	bone = skeleton.AddBone(bone, 0.4f); skeleton.SetRotate(bone, 0.0f,  10.0f, 0.0f); //2nd bone
+	bone = skeleton.AddBone(bone, 0.4f); skeleton.SetRotate(bone, 0.0f, -10.0f, 0.0f); //3nd bone
+	bone = skeleton.AddBone(bone, 0.4f); skeleton.SetRotate(bone, 0.0f,  10.0f, 0.0f); //4nd bone
+	bone = skeleton.AddBone(bone, 0.4f); skeleton.SetRotate(bone, 0.0f, -10.0f, 0.0f); //5th bone
+	bone = skeleton.AddBone(bone, 0.4f); skeleton.SetRotate(bone, 0.0f,  10.0f, 0.0f); //6th end effector bone
 
-	delete root;
+	context.endEffectorIndex = bone;
+	context.target = glm::vec3(0.0f, 1.5f, 0.0f);
+	context.warmStart = true;
+	skeleton.CalcTransforms();
+	FindLeafBones(skeleton, leafBones);
+
+	asyncSolver.Start(context);
+
+	glutMainLoop();
 
 	return 0;
 }
 
 void Update(void)
 {
+	if (asyncSolver.AcquirePose(context.skeleton))
+		ShowSolveResult(asyncSolver.Pose().result);
+
 	glClearColor(0.0f, 0.5f, 0.0f, 1.0f);
 	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
@@ -135,8 +160,8 @@ void Update(void)
 	GLfloat targetMaterialColor[] = { 0.5f, 0.1f, 0.1f, 1.0f };
 	glMaterialfv(GL_FRONT, GL_SPECULAR, targetMaterialColor);
 	glMaterialfv(GL_FRONT, GL_DIFFUSE, targetMaterialColor);
-	glLoadMatrixf(glm::value_ptr(glm::translate(keyCameraRotation, targetPos)));
-	glutSolidSphere(TARGET_RADIUS, TARGET_STACKS_SLICES, TARGET_STACKS_SLICES);
+	glLoadMatrixf(glm::value_ptr(glm::translate(keyCameraRotation, context.target)));
+	glCallList(targetMesh);
 	glPopMatrix();
 
 	//render floor
@@ -148,82 +173,106 @@ void Update(void)
 	glutSolidCube(1.0f);
 	glPopMatrix();
 
-	root->transform = glm::rotate(keyCameraRotation, -90.0f, X_AXIS_3);
-
-	//start drawing sceleton recursively from the root bone
-	DrawSkeleton(root);
+	DrawSkeleton(context.skeleton, leafBones, keyCameraRotation);
 
 	glutSwapBuffers();
 }
 
-void DrawSkeleton(Bone* bone)
+void BuildMeshes(void)
 {
-	glPushMatrix();
+	GLUquadric* quadric = gluNewQuadric();
+	GLuint first = glGenLists(4);
 
-	glm::mat4 lastBoneTransform = bone->transform;
-	glm::mat4 newTransform = bone->transform;
+	targetMesh = first;
+	glNewList(targetMesh, GL_COMPILE);
+	glutSolidSphere(TARGET_RADIUS, TARGET_STACKS_SLICES, TARGET_STACKS_SLICES);
+	glEndList();
 
-	//calculating bone transform matrix
-	if (bone->parent)
-	{
-		newTransform = glm::translate(newTransform, bone->parent->boneLength * Z_AXIS_3);
-		newTransform = glm::rotate(newTransform, bone->rotation.x, glm::vec3(newTransform * X_AXIS_4));
-		newTransform = glm::rotate(newTransform, bone->rotation.y, glm::vec3(newTransform * Y_AXIS_4));
-		newTransform = glm::rotate(newTransform, bone->rotation.z, glm::vec3(newTransform * Z_AXIS_4));
-		newTransform = bone->parent->transform * newTransform;
-	}
-	else
-	{
-		newTransform = glm::rotate(newTransform, bone->rotation.x, X_AXIS_3);
-		newTransform = glm::rotate(newTransform, bone->rotation.y, Y_AXIS_3);
-		newTransform = glm::rotate(newTransform, bone->rotation.z, Z_AXIS_3);
-	}
+	jointMesh = first + 1;
+	glNewList(jointMesh, GL_COMPILE);
+	glutSolidSphere(0.05, BONES_STACKS_SLICES, BONES_STACKS_SLICES);
+	glEndList();
 
-	bone->transform = newTransform;
+	endEffectorMesh = first + 2;
+	glNewList(endEffectorMesh, GL_COMPILE);
+	gluCylinder(quadric, 0.03f, 0.03f, 0.5f, BONES_STACKS_SLICES, BONES_STACKS_SLICES);
+	glEndList();
 
-	//if bone is the last one, draw end effector
-	if (bone->childrenBones.empty()) 
+	//scaling along the cylinder axis does not change normals of its side, so lighting stays right without GL_NORMALIZE
+	boneMesh = first + 3;
+	glNewList(boneMesh, GL_COMPILE);
+	gluCylinder(quadric, 0.01f, 0.01f, 1.0f, BONES_STACKS_SLICES, BONES_STACKS_SLICES);
+	glEndList();
+
+	gluDeleteQuadric(quadric);
+}
+
+void FindLeafBones(const Skeleton& skeleton, std::vector<char>& leafBones)
+{
+	leafBones.assign(skeleton.Size(), 1);
+
+	for (int i = 0; i < skeleton.Size(); i++)
+		if (skeleton.parentIndices[i] >= 0)
+			leafBones[skeleton.parentIndices[i]] = 0;
+}
+
+//draws bones with world transforms of the last FK pass, which the solver thread does once for every pose it publishes,
+//so the viewer has no transform math of its own, leaf bones carry the end effector
+void DrawSkeleton(const Skeleton& skeleton, const std::vector<char>& leafBones, const glm::mat4& viewTransform)
+{
+	for (int i = 0; i < skeleton.Size(); i++)
 	{
 		glPushMatrix();
-		GLfloat endEffectorMaterialColor[] = { 0.5f, 0.0f, 0.0f, 1.0f };
-		glm::mat4 endEffectorOffset = glm::translate(bone->transform, Z_AXIS_3 * bone->boneLength * 0.5f);
-		glLoadMatrixf(glm::value_ptr(endEffectorOffset));
-		glMaterialfv(GL_FRONT, GL_SPECULAR, endEffectorMaterialColor);
-		glMaterialfv(GL_FRONT, GL_DIFFUSE, endEffectorMaterialColor);
-		gluCylinder(gluNewQuadric(), 0.03f, 0.03f, 0.5f, BONES_STACKS_SLICES, BONES_STACKS_SLICES);
-		glPopMatrix();
-	}
 
-	//draw connector between bones
-	glPushMatrix();
-	GLfloat boneConnectorMaterialColor[] = { 0.2f, 0.2f, 0.2f, 1.0 };
-	glLoadMatrixf(glm::value_ptr(bone->transform));
-	glMaterialfv(GL_FRONT, GL_SPECULAR, boneConnectorMaterialColor);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, boneConnectorMaterialColor);
-	glutSolidSphere(0.05, BONES_STACKS_SLICES, BONES_STACKS_SLICES);
-	glPopMatrix();
+		float boneLength = skeleton.boneLengths[i];
+		glm::mat4 transform = viewTransform * skeleton.worldTransforms[i];
 
-	//sending transform and material data to shader
-	glLoadMatrixf(glm::value_ptr(bone->transform));
+		//if bone is the last one, draw end effector
+		if (leafBones[i])
+		{
+			glPushMatrix();
+			GLfloat endEffectorMaterialColor[] = { 0.5f, 0.0f, 0.0f, 1.0f };
+			glm::mat4 endEffectorOffset = glm::translate(transform, Z_AXIS_3 * boneLength * 0.5f);
+			glLoadMatrixf(glm::value_ptr(endEffectorOffset));
+			glMaterialfv(GL_FRONT, GL_SPECULAR, endEffectorMaterialColor);
+			glMaterialfv(GL_FRONT, GL_DIFFUSE, endEffectorMaterialColor);
+			glCallList(endEffectorMesh);
+			glPopMatrix();
+		}
 
-	GLfloat boneMaterialColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
-	glMaterialfv(GL_FRONT, GL_SPECULAR, boneMaterialColor);
-	glMaterialfv(GL_FRONT, GL_DIFFUSE, boneMaterialColor);
+		//draw connector between bones
+		glPushMatrix();
+		GLfloat boneConnectorMaterialColor[] = { 0.2f, 0.2f, 0.2f, 1.0 };
+		glLoadMatrixf(glm::value_ptr(transform));
+		glMaterialfv(GL_FRONT, GL_SPECULAR, boneConnectorMaterialColor);
+		glMaterialfv(GL_FRONT, GL_DIFFUSE, boneConnectorMaterialColor);
+		glCallList(jointMesh);
+		glPopMatrix();
 
-	//draw bones
-	gluCylinder(gluNewQuadric(), 0.01f, 0.01f, bone->boneLength, BONES_STACKS_SLICES, BONES_STACKS_SLICES);
+		//sending transform and material data to shader
+		glLoadMatrixf(glm::value_ptr(transform));
 
-	glPopMatrix();
+		GLfloat boneMaterialColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };
+		glMaterialfv(GL_FRONT, GL_SPECULAR, boneMaterialColor);
+		glMaterialfv(GL_FRONT, GL_DIFFUSE, boneMaterialColor);
 
-	//call this function recursively for all children of the current bone
-	for (auto it = bone->childrenBones.begin(); it != bone->childrenBones.end(); ++it)
-		DrawSkeleton(*it);
+		//draw bones, the root bone may have no length and then there is nothing to draw
+		if (boneLength > 0.0f)
+		{
+			glScalef(1.0f, 1.0f, boneLength);
+			glCallList(boneMesh);
+		}
 
-	bone->transform = lastBoneTransform;
+		glPopMatrix();
+	}
 }
 
 void NextFrame(void)
 {
+	//request is posted only when the target or the solver changes
+	if (trackingMode)
+		asyncSolver.Solve(trackingSolver, context.target, trackingIterationsNum, true);
+
 	glutPostRedisplay();
 }
 
@@ -233,7 +282,15 @@ void OnKeyUp(unsigned char c, int x, int y)
 	{
 	//run ccd
 	case 'c':
-		UpdateBonesAngles();
+		UpdateBonesAngles(IK_SOLVER_CCD, CCD_ITERATIONS_NUM);
+		break;
+	//run fabrik
+	case 'x':
+		UpdateBonesAngles(IK_SOLVER_FABRIK, FABRIK_ITERATIONS_NUM);
+		break;
+	//toggle tracking mode
+	case 't':
+		trackingMode = !trackingMode;
 		break;
 	}
 }
@@ -244,42 +301,42 @@ void OnKeyDown(unsigned char c, int x, int y)
 	{
 	//target position control
 	case 'd':
-		if (targetPos.x + TARGET_CONTROL_SPEED > TARGET_WIDTH_LENGTH_LIMIT / 2)
-			targetPos.x = TARGET_WIDTH_LENGTH_LIMIT / 2;
+		if (context.target.x + TARGET_CONTROL_SPEED > TARGET_WIDTH_LENGTH_LIMIT / 2)
+			context.target.x = TARGET_WIDTH_LENGTH_LIMIT / 2;
 		else
-			targetPos.x += TARGET_CONTROL_SPEED;
+			context.target.x += TARGET_CONTROL_SPEED;
 		break;
 	case 'a':
-		if (targetPos.x - TARGET_CONTROL_SPEED < -TARGET_WIDTH_LENGTH_LIMIT / 2)
-			targetPos.x = -TARGET_WIDTH_LENGTH_LIMIT / 2;
+		if (context.target.x - TARGET_CONTROL_SPEED < -TARGET_WIDTH_LENGTH_LIMIT / 2)
+			context.target.x = -TARGET_WIDTH_LENGTH_LIMIT / 2;
 		else
-			targetPos.x -= TARGET_CONTROL_SPEED;
+			context.target.x -= TARGET_CONTROL_SPEED;
 		break;
 #if ENABLE_HEIGHT_CAMERA_CONTROL
 	case 'r':
-		if (targetPos.y + TARGET_CONTROL_SPEED > TARGET_HEIGHT_MAX_LIMIT)
-			targetPos.y = TARGET_HEIGHT_MAX_LIMIT;
+		if (context.target.y + TARGET_CONTROL_SPEED > TARGET_HEIGHT_MAX_LIMIT)
+			context.target.y = TARGET_HEIGHT_MAX_LIMIT;
 		else
-			targetPos.y += TARGET_CONTROL_SPEED;
+			context.target.y += TARGET_CONTROL_SPEED;
 		break;
 	case 'f':
-		if (targetPos.y - TARGET_CONTROL_SPEED < TARGET_HEIGHT_MIN_LIMIT)
-			targetPos.y = TARGET_HEIGHT_MIN_LIMIT;
+		if (context.target.y - TARGET_CONTROL_SPEED < TARGET_HEIGHT_MIN_LIMIT)
+			context.target.y = TARGET_HEIGHT_MIN_LIMIT;
 		else
-			targetPos.y -= TARGET_CONTROL_SPEED;
+			context.target.y -= TARGET_CONTROL_SPEED;
 		break;
 #endif // ENABLE_HEIGHT_CAMERA_CONTROL
 	case 's':
-		if (targetPos.z + TARGET_CONTROL_SPEED > TARGET_WIDTH_LENGTH_LIMIT / 2)
-			targetPos.z = TARGET_WIDTH_LENGTH_LIMIT / 2;
+		if (context.target.z + TARGET_CONTROL_SPEED > TARGET_WIDTH_LENGTH_LIMIT / 2)
+			context.target.z = TARGET_WIDTH_LENGTH_LIMIT / 2;
 		else
-			targetPos.z += TARGET_CONTROL_SPEED;
+			context.target.z += TARGET_CONTROL_SPEED;
 		break;
 	case 'w':
-		if (targetPos.z - TARGET_CONTROL_SPEED < -TARGET_WIDTH_LENGTH_LIMIT / 2)
-			targetPos.z = -TARGET_WIDTH_LENGTH_LIMIT / 2;
+		if (context.target.z - TARGET_CONTROL_SPEED < -TARGET_WIDTH_LENGTH_LIMIT / 2)
+			context.target.z = -TARGET_WIDTH_LENGTH_LIMIT / 2;
 		else
-			targetPos.z -= TARGET_CONTROL_SPEED;
+			context.target.z -= TARGET_CONTROL_SPEED;
 		break;
 	//camera rotation controls
 	case 'q':
@@ -301,42 +358,23 @@ float RadiansToDegrees(float radians)
 	return radians * 180.0f / PI;
 }
 
-void UpdateBonesAngles()
+//in tracking mode only selects the solver that follows the target on the next frames
+void UpdateBonesAngles(IKSolverType solverType, int maxIterations)
 {
-	bool found = false;
-
-	for (int i = 0; i < CCD_ITERATIONS_NUM; i++)
+	if (trackingMode)
 	{
-		Bone* currentBone = endEffector;
-
-		while (currentBone->parent != NULL)
-		{
-			glm::vec3 startPosition = glm::vec3(currentBone->parent->GetBoneEnd());
-			glm::vec3 endPosition = glm::vec3(currentBone->GetBoneEnd());
-
-			glm::vec3 dirToTarget = glm::normalize(targetPos - startPosition);
-			glm::vec3 dirToEndPos = glm::normalize(endPosition - startPosition);
-
-			if (glm::dot(dirToEndPos, dirToTarget) < 0.99f)
-			{
-				float angle = glm::angle(dirToTarget, dirToEndPos);
-				glm::quat rotation = normalize(glm::angleAxis(angle, cross(dirToEndPos, dirToTarget)));
-				glm::vec3 euler = glm::eulerAngles(rotation);
-				currentBone->CheckConstrainsAndMax(euler);
-			}
-
-			glm::vec3 differnce = glm::vec3(endEffector->GetBoneEnd()) - targetPos;
-
-			currentBone = currentBone->parent;
-
-			if (dot(differnce, differnce) < EPSILON)
-			{
-				found = true;
-				break;
-			}
-		}
-
-		if (found)
-			break;
+		trackingSolver = solverType;
+		trackingIterationsNum = maxIterations;
 	}
-}
\ No newline at end of file
+	else
+		asyncSolver.Solve(solverType, context.target, maxIterations);
+}
+
+//outcome of the last solve (progress on the target in tracking mode) goes to the window title
+void ShowSolveResult(const IKSolveResult& result)
+{
+	char title[128];
+	snprintf(title, sizeof(title), "Project 3 - %s, %d iterations, distance %.4f, %.0f us", result.converged ? "reached" : "not reached",
+		result.iterationsNum, sqrt(result.squaredDistance), result.time);
+	glutSetWindowTitle(title);
+}